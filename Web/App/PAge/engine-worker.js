@@ -0,0 +1,83 @@
+/**
+ * Web Worker that owns the WebAssembly build of searchsystem.cpp
+ * (see wasm/searchsystem_wasm.cpp), so matching never blocks the page.
+ *
+ * Requests are { id, op, ...args } and every one gets a reply
+ * { id, ok, result } or { id, ok: false, error }. Texts arrive as
+ * transferred ArrayBuffers of bytes and are copied once into the module
+ * heap. The first message posted is { ready: true|false }.
+ */
+let engine = null;
+
+// Module heap scratch space for texts, grown as needed
+let scratch = { ptr: 0, size: 0 };
+
+function toHeap(buffer) {
+    const bytes = new Uint8Array(buffer);
+    if (bytes.length > scratch.size) {
+        if (scratch.ptr) engine._free(scratch.ptr);
+        scratch.size = Math.max(bytes.length, 2 * scratch.size, 4096);
+        scratch.ptr = engine._malloc(scratch.size);
+    }
+    engine.HEAPU8.set(bytes, scratch.ptr);
+    return [scratch.ptr, bytes.length];
+}
+
+function checkHandle(result) {
+    if (result < 0) throw new Error("unknown automaton handle");
+    return result === 1;
+}
+
+const ops = {
+    compile({ regex }) {
+        const [ptr, len] = toHeap(new TextEncoder().encode(regex).buffer);
+        const handle = engine._ss_compile(ptr, len);
+        if (!handle) throw new Error(engine.UTF8ToString(engine._ss_error()));
+        const automata = JSON.parse(engine.UTF8ToString(engine._ss_describe(handle)));
+        return { handle, nfa: automata.nfa, dfa: automata.dfa };
+    },
+
+    match({ handle, text }) {
+        const [ptr, len] = toHeap(text);
+        return {
+            nfa: checkHandle(engine._ss_nfa_match(handle, ptr, len)),
+            dfa: checkHandle(engine._ss_match(handle, ptr, len)),
+        };
+    },
+
+    approximate({ handle, text, maxErrors }) {
+        const [ptr, len] = toHeap(text);
+        const result = engine._ss_approx(handle, ptr, len, maxErrors);
+        if (result < 0) throw new Error(engine.UTF8ToString(engine._ss_error()));
+        return result === 1;
+    },
+
+    release({ handle }) {
+        engine._ss_release(handle);
+        return null;
+    },
+};
+
+self.onmessage = ({ data }) => {
+    const { id, op } = data;
+    try {
+        if (!ops[op]) throw new Error(`unknown operation ${op}`);
+        self.postMessage({ id, ok: true, result: ops[op](data) });
+    } catch (error) {
+        self.postMessage({ id, ok: false, error: String(error.message || error) });
+    }
+};
+
+try {
+    importScripts("searchsystem.js");
+    createSearchSystem().then(
+        (module) => {
+            engine = module;
+            self.postMessage({ ready: true });
+        },
+        () => self.postMessage({ ready: false })
+    );
+} catch (error) {
+    // No WebAssembly build next to the page
+    self.postMessage({ ready: false });
+}
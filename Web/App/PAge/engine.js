@@ -0,0 +1,88 @@
+/**
+ * Page-side binding for the WebAssembly engine running in
+ * engine-worker.js. Every call returns a Promise; texts are encoded to
+ * bytes and their buffers transferred to the worker rather than copied.
+ *
+ * SearchEngine.create() resolves to null when Workers, WebAssembly or
+ * the compiled module are unavailable (e.g. the page is opened from
+ * file:// or wasm/build.sh was never run); the page has no other
+ * matchers, so simulator.js then reports the engine as not built.
+ */
+class SearchEngine {
+    constructor(worker) {
+        this.worker = worker;
+        this.nextId = 1;
+        this.pending = new Map();
+        worker.onmessage = ({ data }) => {
+            const request = this.pending.get(data.id);
+            if (!request) return;
+            this.pending.delete(data.id);
+            if (data.ok) request.resolve(data.result);
+            else request.reject(new Error(data.error));
+        };
+        // A crashed worker fails every outstanding request
+        worker.onerror = (event) => {
+            for (const request of this.pending.values()) {
+                request.reject(new Error(event.message || "engine worker failed"));
+            }
+            this.pending.clear();
+        };
+    }
+
+    static create(workerUrl = "engine-worker.js") {
+        if (typeof Worker === "undefined" || typeof WebAssembly === "undefined") {
+            return Promise.resolve(null);
+        }
+        return new Promise((resolve) => {
+            let worker;
+            try {
+                worker = new Worker(workerUrl);
+            } catch (error) {
+                resolve(null);
+                return;
+            }
+            worker.onerror = () => {
+                worker.terminate();
+                resolve(null);
+            };
+            worker.onmessage = ({ data }) => {
+                if (data.ready) {
+                    resolve(new SearchEngine(worker));
+                } else {
+                    worker.terminate();
+                    resolve(null);
+                }
+            };
+        });
+    }
+
+    request(op, args = {}, transfer = []) {
+        const id = this.nextId++;
+        return new Promise((resolve, reject) => {
+            this.pending.set(id, { resolve, reject });
+            this.worker.postMessage({ id, op, ...args }, transfer);
+        });
+    }
+
+    /** Resolves to { handle, nfa, dfa }; nfa and dfa describe the automata for drawing */
+    compile(regex) {
+        return this.request("compile", { regex });
+    }
+
+    /** Resolves to { nfa, dfa }: whether each automaton accepts the whole text */
+    match(handle, text) {
+        const bytes = new TextEncoder().encode(text);
+        return this.request("match", { handle, text: bytes.buffer }, [bytes.buffer]);
+    }
+
+    /** Resolves to true if some part of sequence is within maxErrors edits of the regex */
+    approximate(handle, sequence, maxErrors) {
+        const bytes = new TextEncoder().encode(sequence);
+        return this.request("approximate", { handle, text: bytes.buffer, maxErrors },
+                            [bytes.buffer]);
+    }
+
+    release(handle) {
+        return this.request("release", { handle });
+    }
+}
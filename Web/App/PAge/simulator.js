@@ -1,3 +1,12 @@
+/**
+ * Escapes text for use inside HTML markup; transition labels come from
+ * the user's pattern and may contain <, & or quotes.
+ */
+function escapeHTML(text) {
+    const entities = { '&': '&amp;', '<': '&lt;', '>': '&gt;', '"': '&quot;', "'": '&#39;' };
+    return String(text).replace(/[&<>"']/g, (c) => entities[c]);
+}
+
 class NFA {
     constructor() {
         this.states = new Set([0]);
@@ -16,26 +25,6 @@ class NFA {
         this.states.add(to);
     }
 
-    simulate(input) {
-        let current = new Set([this.startState]);
-        for (const char of input) {
-            let next = new Set();
-            for (const state of current) {
-                if (this.transitions.has(state) && this.transitions.get(state).has(char)) {
-                    for (const nextState of this.transitions.get(state).get(char)) {
-                        next.add(nextState);
-                    }
-                }
-            }
-            current = next;
-            if (current.size === 0) return false;
-        }
-        for (const state of current) {
-            if (this.finalStates.has(state)) return true;
-        }
-        return false;
-    }
-
     getTransitionsLog() {
         let transitionsHTML = '';
         const sortedStates = [...this.states].sort((a, b) => a - b);
@@ -52,7 +41,7 @@ class NFA {
                             <span class="state-dot" style="background-color: ${this.getStateColor(from)}; border-color: ${this.getFinalBorder(from)};"></span>
                             <span class="font-mono bg-blue-100 dark:bg-blue-900 text-blue-800 dark:text-blue-200 px-2 py-1 rounded">${from}</span> 
                             <i class="material-icons mx-2 text-gray-400">arrow_right</i>
-                            <span class="font-mono bg-green-100 dark:bg-green-900 text-green-800 dark:text-green-200 px-2 py-1 rounded mr-2">${symbol}</span>
+                            <span class="font-mono bg-green-100 dark:bg-green-900 text-green-800 dark:text-green-200 px-2 py-1 rounded mr-2">${escapeHTML(symbol)}</span>
                             <i class="material-icons mx-2 text-gray-400">arrow_right</i>
                             <span class="font-mono bg-purple-100 dark:bg-purple-900 text-purple-800 dark:text-purple-200 px-2 py-1 rounded">${to}</span>
                         </div>`;
@@ -82,18 +71,6 @@ class NFA {
  * Represents a Deterministic Finite Automaton (DFA). Inherits methods from NFA.
  */
 class DFA extends NFA {
-    simulate(input) {
-        let current = this.startState;
-        for (const char of input) {
-            if (this.transitions.has(current) && this.transitions.get(current).has(char)) {
-                current = [...this.transitions.get(current).get(char)][0];
-            } else {
-                return false;
-            }
-        }
-        return this.finalStates.has(current);
-    }
-    
     getTransitionsLog() {
         let transitionsHTML = '';
         const sortedStates = [...this.states].sort((a, b) => a - b);
@@ -110,7 +87,7 @@ class DFA extends NFA {
                         <span class="state-dot" style="background-color: ${this.getStateColor(from)}; border-color: ${this.getFinalBorder(from)};"></span>
                         <span class="font-mono bg-blue-100 dark:bg-blue-900 text-blue-800 dark:text-blue-200 px-2 py-1 rounded">${from}</span> 
                         <i class="material-icons mx-2 text-gray-400">arrow_right</i>
-                        <span class="font-mono bg-green-100 dark:bg-green-900 text-green-800 dark:text-green-200 px-2 py-1 rounded mr-2">${symbol}</span>
+                        <span class="font-mono bg-green-100 dark:bg-green-900 text-green-800 dark:text-green-200 px-2 py-1 rounded mr-2">${escapeHTML(symbol)}</span>
                         <i class="material-icons mx-2 text-gray-400">arrow_right</i>
                         <span class="font-mono bg-purple-100 dark:bg-purple-900 text-purple-800 dark:text-purple-200 px-2 py-1 rounded">${to}</span>
                     </div>`;
@@ -122,107 +99,6 @@ class DFA extends NFA {
 }
 
 
-// Simple implementation of regex to NFA conversion (only handles concatenation).
-function regexToNFA(regex) {
-    const nfa = new NFA();
-    let nextState = 1;
-    let lastState = 0;
-
-    for (const c of regex) {
-        nfa.addTransition(lastState, c, nextState);
-        nfa.alphabet.add(c);
-        lastState = nextState;
-        nextState++;
-    }
-    nfa.finalStates.add(lastState);
-    return nfa;
-}
-
-// NFA to DFA conversion using Subset Construction.
-function nfaToDFA(nfa) {
-    const dfa = new DFA();
-    dfa.alphabet = nfa.alphabet;
-    const setToKey = (set) => [...set].sort((a, b) => a - b).join(',');
-    const stateMap = new Map(); 
-    const queue = [];
-    const startSet = new Set([nfa.startState]);
-    const startKey = setToKey(startSet);
-    stateMap.set(startKey, 0);
-    dfa.startState = 0;
-    let nextDFAStateId = 1;
-    queue.push(startSet);
-
-    while (queue.length > 0) {
-        const currentSet = queue.shift();
-        const currentKey = setToKey(currentSet);
-        const currentId = stateMap.get(currentKey);
-        dfa.states.add(currentId);
-        dfa.transitions.set(currentId, new Map());
-
-        for (const char of nfa.alphabet) {
-            let nextSet = new Set();
-            for (const nfaState of currentSet) {
-                const nfaTransitions = nfa.transitions.get(nfaState);
-                if (nfaTransitions && nfaTransitions.has(char)) {
-                    for (const nextNFAState of nfaTransitions.get(char)) {
-                        nextSet.add(nextNFAState);
-                    }
-                }
-            }
-            if (nextSet.size === 0) continue;
-            const nextKey = setToKey(nextSet);
-            let nextId;
-
-            if (!stateMap.has(nextKey)) {
-                nextId = nextDFAStateId++;
-                stateMap.set(nextKey, nextId);
-                queue.push(nextSet);
-            } else {
-                nextId = stateMap.get(nextKey);
-            }
-            dfa.transitions.get(currentId).set(char, new Set([nextId]));
-        }
-        for (const nfaState of currentSet) {
-            if (nfa.finalStates.has(nfaState)) {
-                dfa.finalStates.add(currentId);
-                break;
-            }
-        }
-    }
-    return dfa;
-}
-
-// Approximate Match using Dynamic Programming (Levenshtein distance variant)
-function approximateMatch(sequence, pattern, maxErrors) {
-    const n = sequence.length;
-    const m = pattern.length;
-    const dp = Array(n + 1).fill(0).map(() => Array(m + 1).fill(0));
-    for (let j = 0; j <= m; j++) {
-        dp[0][j] = j;
-    }
-    for (let i = 1; i <= n; i++) {
-        dp[i][0] = 0; 
-        for (let j = 1; j <= m; j++) {
-            if (sequence[i - 1] === pattern[j - 1]) {
-                dp[i][j] = dp[i - 1][j - 1];
-            } else {
-                dp[i][j] = 1 + Math.min(
-                    dp[i - 1][j - 1],
-                    dp[i][j - 1],    
-                    dp[i - 1][j]     
-                );
-            }
-        }
-    }
-    for (let i = m; i <= n; i++) {
-        if (dp[i][m] <= maxErrors) {
-            return true;
-        }
-    }
-    return false;
-}
-
-
 // --- GLOBAL STATE MANAGEMENT (Replaces page.jsx's useState) ---
 const AppState = {
     // Data Inputs
@@ -234,6 +110,10 @@ const AppState = {
     // Automata State
     nfa: null,
     dfa: null,
+    engine: null,         // SearchEngine (WebAssembly worker) once loaded
+    engineStatus: "loading", // "loading" | "ready" | "unavailable" (wasm not built)
+    automataHandle: 0,    // engine handle for the current nfa/dfa
+    generation: 0,        // bumped per generateAutomata call; stale replies are dropped
 
     // UI/Control State
     results: null, // { nfa: bool, dfa: bool, approximate: bool }
@@ -283,12 +163,43 @@ function updateAppState(key, value) {
     updateTestStringInputProps();
 }
 
+/**
+ * Rebuilds an NFA/DFA display object from the engine's description
+ * ({ start, states, finals, transitions: [[from, symbol, to], ...] }).
+ */
+function automatonFromDescription(Type, description) {
+    const automaton = new Type();
+    automaton.states = new Set(description.states);
+    automaton.transitions = new Map();
+    automaton.startState = description.start;
+    automaton.finalStates = new Set(description.finals);
+    for (const [from, symbol, to] of description.transitions) {
+        automaton.addTransition(from, symbol, to);
+        if (symbol !== 'ε') automaton.alphabet.add(symbol);
+    }
+    return automaton;
+}
+
+/**
+ * Drops the engine's automata for the previous pattern, if any.
+ */
+function releaseEngineAutomata() {
+    if (AppState.engine && AppState.automataHandle) {
+        AppState.engine.release(AppState.automataHandle);
+    }
+    AppState.automataHandle = 0;
+}
+
 /**
  * Core function to generate NFA/DFA. (generateAutomata)
+ * Compiles in the WebAssembly engine; until it has loaded there are no
+ * automata to show.
  */
-AppState.generateAutomata = () => {
+AppState.generateAutomata = async () => {
     const regexPattern = AppState.regexPattern;
-    if (!regexPattern.trim()) {
+    const generation = ++AppState.generation;
+    if (!regexPattern.trim() || !AppState.engine) {
+        releaseEngineAutomata();
         updateAppState('nfa', null);
         updateAppState('dfa', null);
         return;
@@ -296,36 +207,51 @@ AppState.generateAutomata = () => {
 
     updateAppState('loading', true);
     try {
-        const newNfa = regexToNFA(regexPattern);
-        const newDfa = nfaToDFA(newNfa);
-        updateAppState('nfa', newNfa);
-        updateAppState('dfa', newDfa);
-
+        const compiled = await AppState.engine.compile(regexPattern);
+        if (generation !== AppState.generation) {
+            // The pattern changed while compiling
+            AppState.engine.release(compiled.handle);
+            return;
+        }
+        releaseEngineAutomata();
+        AppState.automataHandle = compiled.handle;
+        updateAppState('nfa', automatonFromDescription(NFA, compiled.nfa));
+        updateAppState('dfa', automatonFromDescription(DFA, compiled.dfa));
     } catch (error) {
         console.error("Error generating automata:", error);
+        if (generation === AppState.generation) {
+            releaseEngineAutomata();
+            updateAppState('nfa', null);
+            updateAppState('dfa', null);
+        }
     }
-    updateAppState('loading', false);
+    if (generation === AppState.generation) updateAppState('loading', false);
 };
 
 /**
  * Core function to run matching simulations. (testMatching)
  */
-AppState.testMatching = () => {
-    const { nfa, dfa, testString, dnaSequence, regexPattern, maxErrors } = AppState;
+AppState.testMatching = async () => {
+    const { nfa, dfa, testString, dnaSequence, maxErrors,
+            engine, automataHandle } = AppState;
     
-    if (!nfa || !dfa || !testString.trim()) {
+    if (!engine || !automataHandle || !nfa || !dfa || !testString.trim()) {
         updateResultsPanelUI(); 
         return;
     }
 
-    // 1. Exact Match Simulation
-    const nfaResult = nfa.simulate(testString);
-    const dfaResult = dfa.simulate(testString);
-    
-    // 2. Approximate Match Simulation
-    const approxResult = dnaSequence.trim()
-        ? approximateMatch(dnaSequence, regexPattern, maxErrors)
-        : null;
+    let nfaResult, dfaResult, approxResult = null;
+    // Both run in the worker, so large DNA inputs don't freeze the page
+    try {
+        ({ nfa: nfaResult, dfa: dfaResult } =
+            await engine.match(automataHandle, testString));
+        if (dnaSequence.trim()) {
+            approxResult = await engine.approximate(automataHandle, dnaSequence, maxErrors);
+        }
+    } catch (error) {
+        console.error("Error running matchers:", error);
+        return;
+    }
 
     const newResults = {
         nfa: nfaResult,
@@ -380,7 +306,7 @@ function updateRegexInputUI() {
     const button = document.getElementById('generate-automata-button');
     const textSpan = document.getElementById('generate-automata-text');
 
-    const isDisabled = !AppState.regexPattern.trim() || AppState.loading;
+    const isDisabled = !AppState.regexPattern.trim() || AppState.loading || !AppState.engine;
 
     if (textSpan) {
         textSpan.textContent = AppState.loading ? "Generating..." : "Generate Automata";
@@ -392,7 +318,8 @@ function updateRegexInputUI() {
 
 function updateTestStringInputProps() {
     const testButton = document.getElementById('test-match-button');
-    const isDisabled = !AppState.nfa || !AppState.dfa || !AppState.testString.trim();
+    const isDisabled = !AppState.automataHandle || !AppState.nfa || !AppState.dfa ||
+                       !AppState.testString.trim();
 
     if (testButton) {
         testButton.disabled = isDisabled;
@@ -404,6 +331,24 @@ function updateApproximateMatchInputProps() {
     document.getElementById('max-errors-field').value = AppState.maxErrors;
 }
 
+/**
+ * Shows whether the WebAssembly engine is still loading or was never
+ * built; hidden once it is ready.
+ */
+function updateEngineStatusUI() {
+    const status = document.getElementById('engine-status');
+    if (!status) return;
+    const messages = {
+        loading: "Loading the matching engine...",
+        unavailable: "The matching engine (searchsystem.wasm) is not built. " +
+                     "Run wasm/build.sh from the repository root with Emscripten " +
+                     "installed, then reload this page over http://.",
+    };
+    status.style.display = AppState.engineStatus === "ready" ? 'none' : 'block';
+    status.className = `engine-status ${AppState.engineStatus}`;
+    status.textContent = messages[AppState.engineStatus] || "";
+}
+
 /**
  * Rerenders the TransitionsPanel content based on the current AppState (nfa, dfa, activeTab).
  */
@@ -789,9 +734,25 @@ function initializeApp() {
     document.getElementById('nfa-log').style.display = (logTab === 'nfa' ? 'block' : 'none');
     document.getElementById('dfa-log').style.display = (logTab === 'dfa' ? 'block' : 'none');
     
+    updateEngineStatusUI();
+
     // Initial generation of automata based on default regex
     AppState.generateAutomata(); 
 }
 
 // Start the application after the DOM loads
-document.addEventListener('DOMContentLoaded', initializeApp);
\ No newline at end of file
+document.addEventListener('DOMContentLoaded', initializeApp);
+
+// All matching runs in the WebAssembly engine; until it loads, or if it
+// was never built, the page says so and the buttons stay disabled
+const enginePromise = typeof SearchEngine !== 'undefined'
+    ? SearchEngine.create()
+    : Promise.resolve(null);
+enginePromise.then((engine) => {
+    AppState.engine = engine;
+    AppState.engineStatus = engine ? "ready" : "unavailable";
+    // Before DOMContentLoaded, initializeApp does both
+    if (document.readyState === 'loading') return;
+    updateEngineStatusUI();
+    AppState.generateAutomata();
+});
\ No newline at end of file
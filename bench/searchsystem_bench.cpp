@@ -0,0 +1,495 @@
+/* Benchmarks for the searchsystem.cpp engines.
+
+   Build from the repository root:
+       g++ -std=c++17 -O2 -pthread -o searchsystem_bench \
+           bench/searchsystem_bench.cpp
+
+   Usage:
+       searchsystem_bench [--max-bytes N[K|M|G]] [--max-states N]
+                          [--min-time SECONDS] [--filter SUBSTRING] [--csv]
+
+   Scan cases run over synthetic corpora (uniform random ACGT, and random
+   lowercase words) at 1K, 64K, 1M, 16M, 256M and 1G bytes, up to
+   --max-bytes (default 16M; pass 1G for the full sweep). The map-based
+   reference engines are capped lower so a run stays short. Approximate
+   cases use pattern lengths 4..1024. Compile cases time each pattern
+   through regexToNFA, nfaToDFA, minimizeDFA and compileRegex: literals of
+   length 4..1024, and ".*a" followed by k dots, whose DFA has 2^(k+1)
+   states (up to --max-states, default 131072).
+
+   Each case is repeated until --min-time (default 0.2s) has passed and
+   reports the mean time per run, plus throughput for scans or the state
+   count for compiles. --csv prints the same columns comma separated, so
+   two runs can be diffed against a saved baseline. */
+#define SEARCHSYSTEM_NO_MAIN
+#include "../searchsystem.cpp"
+
+#include <cstdio>
+#include <random>
+
+namespace {
+
+struct Options {
+    size_t maxBytes = 16 << 20;
+    size_t maxStates = 1 << 17;
+    double minTime = 0.2;
+    string filter;
+    bool csv = false;
+};
+
+Options opt;
+volatile uint64_t sink;   /* keeps results observable */
+
+const size_t SIZES[] = {1 << 10, 64 << 10, 1 << 20, 16 << 20, 256 << 20,
+                        1 << 30};
+
+bool selected(const string &name) {
+    return opt.filter.empty() || name.find(opt.filter) != string::npos;
+}
+
+/* Mean seconds per call of fn, over at least minTime */
+template <class F>
+double timeIt(F &&fn) {
+    using clock = chrono::steady_clock;
+    size_t runs = 0;
+    double elapsed;
+    auto t0 = clock::now();
+    do {
+        fn();
+        runs++;
+        elapsed = chrono::duration<double>(clock::now() - t0).count();
+    } while (elapsed < opt.minTime);
+    return elapsed / runs;
+}
+
+string humanBytes(double n) {
+    const char *units[] = {"B", "KB", "MB", "GB"};
+    int u = 0;
+    while (n >= 1024 && u < 3) { n /= 1024; u++; }
+    char buf[32];
+    snprintf(buf, sizeof buf, "%.4g %s", n, units[u]);
+    return buf;
+}
+
+string humanTime(double s) {
+    char buf[32];
+    if (s < 1e-6)      snprintf(buf, sizeof buf, "%.3g ns", s * 1e9);
+    else if (s < 1e-3) snprintf(buf, sizeof buf, "%.3g us", s * 1e6);
+    else if (s < 1)    snprintf(buf, sizeof buf, "%.3g ms", s * 1e3);
+    else               snprintf(buf, sizeof buf, "%.3g s", s);
+    return buf;
+}
+
+void header() {
+    if (opt.csv)
+        cout << "name,param,seconds,bytes_per_second,states\n";
+    else
+        printf("%-36s %10s %12s %14s\n", "case", "param", "time", "rate");
+}
+
+/* A scan over `bytes` input bytes */
+void reportScan(const string &name, size_t bytes, double secs) {
+    if (opt.csv)
+        cout << name << "," << bytes << "," << secs << ","
+             << bytes / secs << ",\n";
+    else
+        printf("%-36s %10s %12s %12s/s\n", name.c_str(),
+               humanBytes(bytes).c_str(), humanTime(secs).c_str(),
+               humanBytes(bytes / secs).c_str());
+    fflush(stdout);
+}
+
+/* A compile of a pattern of length `param`, yielding `states` states */
+void reportCompile(const string &name, size_t param, double secs,
+                   size_t states) {
+    if (opt.csv)
+        cout << name << "," << param << "," << secs << ",," << states << "\n";
+    else
+        printf("%-36s %10zu %12s %9zu states\n", name.c_str(), param,
+               humanTime(secs).c_str(), states);
+    fflush(stdout);
+}
+
+/* ---------- corpora ---------- */
+
+string dnaCorpus(size_t n, uint32_t seed) {
+    mt19937 rng(seed);
+    string s(n, 'A');
+    for (size_t i = 0; i < n; i += 16) {
+        uint32_t r = rng();
+        for (size_t j = i; j < min(n, i + 16); j++, r >>= 2)
+            s[j] = "ACGT"[r & 3];
+    }
+    return s;
+}
+
+string textCorpus(size_t n, uint32_t seed) {
+    mt19937 rng(seed);
+    string s;
+    s.reserve(n);
+    while (s.size() < n) {
+        size_t len = 1 + rng() % 9;
+        for (size_t j = 0; j < len; j++) s += (char)('a' + rng() % 26);
+        s += rng() % 12 ? ' ' : '\n';
+    }
+    s.resize(n);
+    return s;
+}
+
+/* Sizes up to both --max-bytes and an engine-specific cap */
+vector<size_t> sizesUpTo(size_t cap) {
+    vector<size_t> out;
+    for (size_t n : SIZES)
+        if (n <= opt.maxBytes && n <= cap) out.push_back(n);
+    return out;
+}
+
+/* ---------- scan engines ---------- */
+
+/* Every engine gets a pattern that never dies on the corpus, so each run
+   reads all its input */
+void scanEngines(const string &corpusName, const string &corpus,
+                 const string &wholeRegex, const string &searchRegex) {
+    string prefix = "scan/" + corpusName + "/";
+    NFA nfa = regexToNFA(wholeRegex);
+    DFA dfa = nfaToDFA(nfa);
+    FlatDFA flat = compileDFA(dfa, true);
+    BitNFA bits = compileBitNFA(nfa);
+    Searcher searcher(regexToNFA(searchRegex));
+    FlatDFA anchored = compileRegex(searchRegex);
+    Prefilter pf = buildPrefilter(anchored, anchored.startState,
+                                  anchored.deadState);
+    ThreadPool pool;
+
+    for (size_t n : sizesUpTo(64 << 10)) {
+        if (!selected(prefix + "nfa")) break;
+        string in = corpus.substr(0, n);
+        reportScan(prefix + "nfa", n, timeIt([&] {
+            sink = nfa.simulate(in);
+        }));
+    }
+    for (size_t n : sizesUpTo(16 << 20)) {
+        if (!selected(prefix + "dfa")) break;
+        string in = corpus.substr(0, n);
+        reportScan(prefix + "dfa", n, timeIt([&] {
+            sink = dfa.simulate(in);
+        }));
+    }
+    for (size_t n : sizesUpTo(SIZE_MAX)) {
+        string_view in(corpus.data(), n);
+        if (selected(prefix + "flat"))
+            reportScan(prefix + "flat", n, timeIt([&] {
+                sink = flat.simulate(in);
+            }));
+        if (selected(prefix + "lazy")) {
+            LazyDFA lazy(nfa);
+            reportScan(prefix + "lazy", n, timeIt([&] {
+                sink = lazy.simulate(in);
+            }));
+        }
+        if (selected(prefix + "bitnfa"))
+            reportScan(prefix + "bitnfa", n, timeIt([&] {
+                sink = bits.simulate(in);
+            }));
+        if (selected(prefix + "parallel"))
+            reportScan(prefix + "parallel", n, timeIt([&] {
+                sink = parallelSimulate(flat, in, pool);
+            }));
+        if (selected(prefix + "search"))
+            reportScan(prefix + "search", n, timeIt([&] {
+                sink = searcher.count(in);
+            }));
+        if (selected(prefix + "candidates"))
+            reportScan(prefix + "candidates", n, timeIt([&] {
+                sink = scanCandidates(anchored, pf, in,
+                                      [](size_t, size_t) {});
+            }));
+    }
+}
+
+void ahoCorasickScan(const string &dna) {
+    string name = "scan/dna/ahocorasick";
+    if (!selected(name)) return;
+    vector<string> patterns;
+    for (int i = 0; i < 64; i++) patterns.push_back(dnaCorpus(12, 100 + i));
+    AhoCorasick ac = buildAhoCorasick(patterns);
+    for (size_t n : sizesUpTo(SIZE_MAX)) {
+        string_view in(dna.data(), n);
+        reportScan(name, n, timeIt([&] {
+            uint64_t hits = 0;
+            ac.search(in, [&](uint32_t, size_t) { hits++; });
+            sink = hits;
+        }));
+    }
+}
+
+constexpr char PRIMER[] = "GATTACA";
+
+/* Many short reads against one DFA: the lockstep batch API, alone and
+   split across the pool, and the first seven bases of each read against
+   one literal through the compile-time table and through the flat DFA
+   built at run time */
+void batchScan(const string &dna) {
+    if (!selected("batch/")) return;
+    FlatDFA flat = compileRegex("[ACGT]*GATTACA");
+    FlatDFA literal = compileRegex(PRIMER);
+    ThreadPool pool;
+    for (size_t n : sizesUpTo(256 << 20)) {
+        vector<string_view> reads;
+        for (size_t i = 0; i + 32 <= n; i += 32)
+            reads.push_back(string_view(dna.data() + i, 32));
+        if (selected("batch/lanes"))
+            reportScan("batch/lanes", n, timeIt([&] {
+                sink = batchSimulate(flat, reads)[0];
+            }));
+        if (selected("batch/pooled"))
+            reportScan("batch/pooled", n, timeIt([&] {
+                sink = batchSimulate(flat, reads, pool)[0];
+            }));
+        if (selected("batch/static"))
+            reportScan("batch/static", reads.size() * 7, timeIt([&] {
+                uint64_t hits = 0;
+                for (string_view r : reads)
+                    hits += StaticLiteral<PRIMER>::simulate(r.substr(0, 7));
+                sink = hits;
+            }));
+        if (selected("batch/literal"))
+            reportScan("batch/literal", reads.size() * 7, timeIt([&] {
+                uint64_t hits = 0;
+                for (string_view r : reads)
+                    hits += literal.simulate(r.substr(0, 7));
+                sink = hits;
+            }));
+    }
+}
+
+/* Two bits per base: the encoder, whole and in 4 KB appends, and the
+   DFA and Myers scans that read the packed words directly */
+void packedScan(const string &dna) {
+    FlatDFA flat = compileRegex("[ACGT]*GATTACA");
+    PackedDFA packed(flat);
+    string pattern = dnaCorpus(64, 71);
+    for (size_t n : sizesUpTo(SIZE_MAX)) {
+        string_view in(dna.data(), n);
+        if (selected("packed/encode"))
+            reportScan("packed/encode", n, timeIt([&] {
+                sink = PackedDNA(in).size();
+            }));
+        /* Streaming input arrives in small reads */
+        if (selected("packed/append"))
+            reportScan("packed/append", n, timeIt([&] {
+                PackedDNA bases;
+                for (size_t i = 0; i < n; i += 4096)
+                    bases.append(in.substr(i, 4096));
+                sink = bases.size();
+            }));
+        if (!selected("packed/dfa") && !selected("packed/myers")) continue;
+        PackedDNA bases(in);
+        if (selected("packed/dfa"))
+            reportScan("packed/dfa", n, timeIt([&] {
+                sink = packed.simulate(bases);
+            }));
+        if (selected("packed/myers"))
+            reportScan("packed/myers", n, timeIt([&] {
+                sink = approximateMatchMyers(bases, pattern, 8);
+            }));
+    }
+}
+
+/* ---------- approximate matching ---------- */
+
+void approximate(const string &dna) {
+    for (size_t m : {4, 16, 64, 256, 1024}) {
+        int k = max<int>(1, m / 8);
+        string pattern = dnaCorpus(m, 7 + m);
+        /* 'N' never occurs in the corpus: approximateMatch reads it all */
+        string absent(m, 'N');
+        string tag = "/m" + to_string(m);
+
+        for (size_t n : sizesUpTo(64 << 10)) {
+            if (m > 64 || !selected("approx/dp" + tag)) break;
+            string_view in(dna.data(), n);
+            reportScan("approx/dp" + tag, n, timeIt([&] {
+                sink = approximateMatchDP(in, absent, k);
+            }));
+        }
+        for (size_t n : sizesUpTo(SIZE_MAX)) {
+            string_view in(dna.data(), n);
+            if (selected("approx/myers" + tag))
+                reportScan("approx/myers" + tag, n, timeIt([&] {
+                    sink = approximateMatchMyers(in, absent, k);
+                }));
+            /* Seeding needs pieces of a dozen bytes, so fewer edits */
+            if (m >= 64 && selected("approx/filtered" + tag))
+                reportScan("approx/filtered" + tag, n, timeIt([&] {
+                    sink = approximateMatchFiltered(in, pattern, m / 32);
+                }));
+            if (selected("approx/ukkonen" + tag))
+                reportScan("approx/ukkonen" + tag, n, timeIt([&] {
+                    sink = approximateMatchUkkonen(in, absent, k);
+                }));
+            if (m <= 64 && selected("approx/wumanber" + tag))
+                reportScan("approx/wumanber" + tag, n, timeIt([&] {
+                    sink = approximateMatchWuManber(in, absent, k);
+                }));
+            if (selected("approx/stream" + tag))
+                reportScan("approx/stream" + tag, n, timeIt([&] {
+                    ApproxStream stream(pattern, k);
+                    uint64_t hits = 0;
+                    stream.feed(in, [&](size_t, int) { hits++; });
+                    sink = hits;
+                }));
+        }
+    }
+}
+
+/* ---------- PDA and CFG ---------- */
+
+string nestedBrackets(size_t n, uint32_t seed) {
+    mt19937 rng(seed);
+    string s, open;
+    while (s.size() + open.size() < n) {
+        if (open.empty() || (open.size() < 64 && rng() % 2)) {
+            char c = "([{"[rng() % 3];
+            s += c;
+            open += c == '(' ? ')' : c == '[' ? ']' : '}';
+        } else {
+            s += open.back();
+            open.pop_back();
+        }
+    }
+    s.append(open.rbegin(), open.rend());
+    return s;
+}
+
+void pushdown() {
+    PDA anbn = PDA::anbn();
+    PDA balanced = PDA::balanced("()[]{}");
+    Grammar dyck;
+    int S = dyck.nonterminal("S");
+    dyck.addRule(S, {});
+    for (const char *p : {"()", "[]", "{}"})
+        dyck.addRule(S, {S, Grammar::terminal(p[0]), S,
+                         Grammar::terminal(p[1])});
+
+    for (size_t n : sizesUpTo(SIZE_MAX)) {
+        if (selected("pda/anbn")) {
+            string in = string(n / 2, 'a') + string(n - n / 2, 'b');
+            reportScan("pda/anbn", n, timeIt([&] {
+                sink = anbn.simulate(in);
+            }));
+        }
+        if (selected("pda/balanced")) {
+            string in = nestedBrackets(n, 3);
+            reportScan("pda/balanced", in.size(), timeIt([&] {
+                sink = balanced.simulate(in);
+            }));
+        }
+    }
+    for (size_t n : sizesUpTo(1 << 20)) {
+        if (!selected("cfg/earley")) break;
+        string in = nestedBrackets(n, 5);
+        reportScan("cfg/earley", in.size(), timeIt([&] {
+            sink = earleyRecognize(dyck, in);
+        }));
+    }
+}
+
+/* ---------- compilation ---------- */
+
+void compileCase(const string &name, const string &regex, size_t param) {
+    if (selected(name + "/nfaToDFA")) {
+        NFA nfa = regexToNFA(regex);
+        size_t states = 0;
+        double t = timeIt([&] { states = nfaToDFA(nfa).states.size(); });
+        reportCompile(name + "/nfaToDFA", param, t, states);
+    }
+    if (selected(name + "/minimize")) {
+        DFA dfa = nfaToDFA(regexToNFA(regex));
+        size_t states = 0;
+        double t = timeIt([&] { states = minimizeDFA(dfa).states.size(); });
+        reportCompile(name + "/minimize", param, t, states);
+    }
+    if (selected(name + "/compileRegex")) {
+        size_t states = 0;
+        double t = timeIt([&] { states = compileRegex(regex).numStates; });
+        reportCompile(name + "/compileRegex", param, t, states);
+    }
+}
+
+void compilation() {
+    for (size_t m : {4, 16, 64, 256, 1024})
+        compileCase("compile/literal", dnaCorpus(m, 11 + m), m);
+
+    /* The unanchored "a then k symbols" language: the DFA must remember
+       the last k+1 bytes */
+    for (size_t k = 2; (size_t(2) << k) <= opt.maxStates; k += 2)
+        compileCase("compile/dots", ".*a" + string(k, '.'), k);
+
+    /* Scanning with the largest table, which no longer fits in cache */
+    size_t k = 0;
+    while ((size_t(4) << k) <= opt.maxStates) k++;
+    string name = "scan/bigdfa/dots" + to_string(k);
+    if (k && selected(name)) {
+        string regex = "[ab]*a";
+        for (size_t i = 0; i < k; i++) regex += "[ab]";
+        FlatDFA flat = compileRegex(regex);
+        string ab = textCorpus(opt.maxBytes, 9);
+        for (char &c : ab) c = 'a' + (c & 1);
+        for (size_t n : sizesUpTo(SIZE_MAX))
+            reportScan(name, n, timeIt([&] {
+                sink = flat.simulate(string_view(ab.data(), n));
+            }));
+    }
+}
+
+size_t parseSize(const string &s) {
+    size_t mult = 1;
+    string digits = s;
+    if (!s.empty()) {
+        switch (toupper((unsigned char)s.back())) {
+        case 'K': mult = 1 << 10; break;
+        case 'M': mult = 1 << 20; break;
+        case 'G': mult = 1 << 30; break;
+        }
+        if (mult > 1) digits.pop_back();
+    }
+    return stoull(digits) * mult;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (a == "--max-bytes" && hasValue)       opt.maxBytes = parseSize(argv[++i]);
+        else if (a == "--max-states" && hasValue) opt.maxStates = parseSize(argv[++i]);
+        else if (a == "--min-time" && hasValue)   opt.minTime = atof(argv[++i]);
+        else if (a == "--filter" && hasValue)     opt.filter = argv[++i];
+        else if (a == "--csv") opt.csv = true;
+        else {
+            cerr << "usage: " << argv[0] << " [--max-bytes N[K|M|G]]"
+                 << " [--max-states N] [--min-time SECONDS]"
+                 << " [--filter SUBSTRING] [--csv]\n";
+            return 2;
+        }
+    }
+
+    header();
+    string dna = dnaCorpus(opt.maxBytes, 1);
+    scanEngines("dna", dna, "[ACGT]*GATTACA", "GATTACA");
+    ahoCorasickScan(dna);
+    batchScan(dna);
+    packedScan(dna);
+    approximate(dna);
+    dna = string();
+
+    string text = textCorpus(opt.maxBytes, 2);
+    scanEngines("text", text, "[a-z \n]*needle", "(error|warn)[a-z]*");
+    text = string();
+
+    pushdown();
+    compilation();
+    return 0;
+}
@@ -1,245 +1,4479 @@
-#include <iostream>
-#include <vector>
-#include <map>
-#include <set>
-#include <queue>
-#include <stack>
-#include <string>
-#include <algorithm>
-#include <limits>
-
-using namespace std;
-
-/* ====================== NFA ====================== */
-struct NFA {
-    set<int> states;
-    set<char> alphabet;
-    map<int, map<char, set<int>>> transitions;
-    int startState;
-    set<int> finalStates;
-
-    void addTransition(int from, char symbol, int to) {
-        transitions[from][symbol].insert(to);
-    }
-
-    bool simulate(const string &input) {
-        set<int> current = {startState};
-
-        for (char c : input) {
-            set<int> next;
-            for (int s : current) {
-                if (transitions[s].count(c)) {
-                    next.insert(transitions[s][c].begin(),
-                                transitions[s][c].end());
-                }
-            }
-            current = next;
-            if (current.empty()) return false;
-        }
-
-        for (int s : current)
-            if (finalStates.count(s)) return true;
-        return false;
-    }
-
-    void printTransitions() {
-        cout << "\nNFA Transitions:\n";
-        for (auto &[from, mp] : transitions)
-            for (auto &[c, tos] : mp)
-                for (int t : tos)
-                    cout << "  " << from << " --" << c << "--> " << t << "\n";
-
-        cout << "Start: " << startState << "\nFinal: ";
-        for (int f : finalStates) cout << f << " ";
-        cout << "\n";
-    }
-};
-
-/* ====================== Regex → NFA ====================== */
-/* Literal concatenation only */
-NFA regexToNFA(const string &regex) {
-    NFA nfa;
-    int next = 1;
-    nfa.startState = 0;
-    nfa.states.insert(0);
-
-    int last = 0;
-    for (char c : regex) {
-        nfa.addTransition(last, c, next);
-        nfa.states.insert(next);
-        nfa.alphabet.insert(c);
-        last = next++;
-    }
-
-    nfa.finalStates.insert(last);
-    return nfa;
-}
-
-/* ====================== DFA ====================== */
-struct DFA {
-    set<int> states;
-    set<char> alphabet;
-    map<int, map<char, int>> transitions;
-    int startState;
-    set<int> finalStates;
-
-    bool simulate(const string &input) {
-        int current = startState;
-        for (char c : input) {
-            if (!transitions[current].count(c))
-                return false;
-            current = transitions[current][c];
-        }
-        return finalStates.count(current);
-    }
-
-    void printTransitions() {
-        cout << "\nDFA Transitions:\n";
-        for (auto &[from, mp] : transitions)
-            for (auto &[c, to] : mp)
-                cout << "  " << from << " --" << c << "--> " << to << "\n";
-
-        cout << "Start: " << startState << "\nFinal: ";
-        for (int f : finalStates) cout << f << " ";
-        cout << "\n";
-    }
-};
-
-/* ====================== NFA → DFA ====================== */
-DFA nfaToDFA(NFA &nfa) {
-    DFA dfa;
-    dfa.alphabet = nfa.alphabet;
-
-    map<set<int>, int> id;
-    queue<set<int>> q;
-
-    set<int> start = {nfa.startState};
-    id[start] = 0;
-    dfa.startState = 0;
-    q.push(start);
-
-    int nextId = 1;
-
-    while (!q.empty()) {
-        auto cur = q.front(); q.pop();
-        int cid = id[cur];
-        dfa.states.insert(cid);
-
-        for (char c : dfa.alphabet) {
-            set<int> next;
-            for (int s : cur)
-                if (nfa.transitions[s].count(c))
-                    next.insert(nfa.transitions[s][c].begin(),
-                                nfa.transitions[s][c].end());
-
-            if (next.empty()) continue;
-
-            if (!id.count(next)) {
-                id[next] = nextId++;
-                q.push(next);
-            }
-
-            dfa.transitions[cid][c] = id[next];
-        }
-
-        for (int s : cur)
-            if (nfa.finalStates.count(s))
-                dfa.finalStates.insert(cid);
-    }
-
-    return dfa;
-}
-
-/* ====================== Approximate Matching ====================== */
-bool approximateMatch(const string &text,
-                      const string &pattern,
-                      int maxErrors) {
-    int n = text.size(), m = pattern.size();
-    vector<vector<int>> dp(n+1, vector<int>(m+1));
-
-    for (int j = 0; j <= m; j++) dp[0][j] = j;
-
-    for (int i = 1; i <= n; i++) {
-        dp[i][0] = 0;
-        for (int j = 1; j <= m; j++) {
-            if (text[i-1] == pattern[j-1])
-                dp[i][j] = dp[i-1][j-1];
-            else
-                dp[i][j] = 1 + min({ dp[i-1][j],
-                                     dp[i][j-1],
-                                     dp[i-1][j-1] });
-        }
-    }
-
-    for (int i = m; i <= n; i++)
-        if (dp[i][m] <= maxErrors) return true;
-
-    return false;
-}
-
-/* ====================== PDA ====================== */
-/* Language: a^n b^n */
-struct PDA {
-    bool simulate(const string &input) {
-        stack<char> st;
-        int i = 0;
-
-        /* Push phase: read a's */
-        while (i < input.size() && input[i] == 'a') {
-            st.push('A');
-            i++;
-        }
-
-        /* Pop phase: read b's */
-        while (i < input.size() && input[i] == 'b') {
-            if (st.empty()) return false;
-            st.pop();
-            i++;
-        }
-
-        return i == input.size() && st.empty();
-    }
-};
-
-/* ====================== MAIN ====================== */
-int main() {
-    cout << "=== Formal Language Simulator ===\n";
-
-    string regex;
-    cout << "\nEnter regex (literal concatenation): ";
-    cin >> regex;
-
-    NFA nfa = regexToNFA(regex);
-    nfa.printTransitions();
-
-    DFA dfa = nfaToDFA(nfa);
-    dfa.printTransitions();
-
-    string test;
-    cout << "\nEnter string for exact match: ";
-    cin >> test;
-
-    cout << (nfa.simulate(test) ? "NFA ACCEPT\n" : "NFA REJECT\n");
-    cout << (dfa.simulate(test) ? "DFA ACCEPT\n" : "DFA REJECT\n");
-
-    string dna;
-    cout << "\nEnter DNA sequence for approximate matching: ";
-    cin >> dna;
-
-    if (approximateMatch(dna, regex, 1))
-        cout << "Approximate match found\n";
-    else
-        cout << "No approximate match\n";
-
-    /* PDA Section */
-    PDA pda;
-    string cfl;
-    cout << "\nEnter string for PDA test (a^n b^n): ";
-    cin >> cfl;
-
-    cout << (pda.simulate(cfl)
-            ? "PDA ACCEPT (Context-Free Language)\n"
-            : "PDA REJECT\n");
-
-    return 0;
-}
+#include <iostream>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <set>
+#include <queue>
+#include <stack>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <istream>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <bitset>
+#include <stdexcept>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <charconv>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define SEARCHSYSTEM_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#define SEARCHSYSTEM_AVX2 1
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define SEARCHSYSTEM_NEON 1
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <csignal>
+#else
+#include <io.h>
+#endif
+
+using namespace std;
+
+/* ====================== Arena ====================== */
+/* Monotonic allocator for automaton construction: allocations bump
+   through geometrically growing blocks, deallocate is a no-op, and the
+   whole lot goes back in one shot on release() or destruction. Building
+   an NFA/DFA in an Arena replaces one heap node per map and set entry
+   with a few large blocks. Not thread-safe; anything allocated from it
+   must not outlive it. */
+class Arena : public pmr::memory_resource {
+public:
+    explicit Arena(size_t initialBytes = 64 << 10) : buffer(initialBytes) {}
+
+    size_t bytesAllocated() const { return bytes; }
+
+    void release() {
+        buffer.release();
+        bytes = 0;
+    }
+
+private:
+    pmr::monotonic_buffer_resource buffer;
+    size_t bytes = 0;
+
+    void *do_allocate(size_t n, size_t align) override {
+        bytes += n;
+        return buffer.allocate(n, align);
+    }
+    void do_deallocate(void *, size_t, size_t) override {}
+    bool do_is_equal(const memory_resource &o) const noexcept override {
+        return this == &o;
+    }
+};
+
+/* ====================== Engine Stats ====================== */
+/* Hot-path counters, kept per thread: the owning thread updates its
+   block with relaxed loads and stores (no locked read-modify-write, no
+   shared cache lines) and engines report once per call, not per byte.
+   statsSnapshot() adds up the live blocks and those of exited threads.
+   Define SEARCHSYSTEM_NO_STATS to compile every update away. */
+enum Stat : uint32_t {
+    StatBytesScanned,
+    StatDFATransitions,
+    StatDeadExits,
+    StatSubsetStates,
+    StatNFAToDFACalls,
+    StatNFAToDFANanos,
+    StatDPCells,
+    StatPDAStackPeak,
+    StatPatternHits,
+    StatPatternMisses,
+    StatPatternEvictions,
+    NumStats
+};
+
+struct StatInfo {
+    const char *name;
+    const char *help;
+    bool isMax;          /* merged by max (a high-water mark), not summed */
+};
+
+static const StatInfo STAT_INFO[NumStats] = {
+    {"bytes_scanned", "Input bytes read by all engines", false},
+    {"dfa_transitions", "Table moves taken by DFA, LazyDFA and FlatDFA",
+     false},
+    {"dfa_dead_exits", "Scans cut short by reaching a dead state", false},
+    {"subset_states", "DFA states created by nfaToDFA and LazyDFA", false},
+    {"nfa_to_dfa_calls", "Completed nfaToDFA calls", false},
+    {"nfa_to_dfa_nanoseconds", "Time spent in nfaToDFA", false},
+    {"dp_cells", "Edit-distance cells evaluated (bit-parallel included)",
+     false},
+    {"pda_stack_high_water", "Deepest PDA stack seen", true},
+    {"pattern_cache_hits", "PatternCache lookups served from cache", false},
+    {"pattern_cache_misses", "PatternCache lookups that compiled", false},
+    {"pattern_cache_evictions", "PatternCache entries evicted", false},
+};
+
+using StatsSnapshot = array<uint64_t, NumStats>;
+
+#ifndef SEARCHSYSTEM_NO_STATS
+struct ThreadStats {
+    array<atomic<uint64_t>, NumStats> values{};
+
+    struct Registry {
+        mutex lock;
+        vector<ThreadStats *> live;
+        StatsSnapshot retired{};
+    };
+
+    /* Never destroyed, so exiting threads can always fold into it */
+    static Registry &registry() {
+        static Registry *r = new Registry;
+        return *r;
+    }
+
+    ThreadStats() {
+        Registry &r = registry();
+        lock_guard<mutex> g(r.lock);
+        r.live.push_back(this);
+    }
+
+    ~ThreadStats() {
+        Registry &r = registry();
+        lock_guard<mutex> g(r.lock);
+        merge(r.retired);
+        r.live.erase(find(r.live.begin(), r.live.end(), this));
+    }
+
+    void merge(StatsSnapshot &into) const {
+        for (uint32_t i = 0; i < NumStats; i++) {
+            uint64_t v = values[i].load(memory_order_relaxed);
+            into[i] = STAT_INFO[i].isMax ? max(into[i], v) : into[i] + v;
+        }
+    }
+};
+
+inline atomic<uint64_t> &statSlot(Stat s) {
+    thread_local ThreadStats local;
+    return local.values[s];
+}
+
+inline void statAdd(Stat s, uint64_t n) {
+    atomic<uint64_t> &v = statSlot(s);
+    v.store(v.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+inline void statMax(Stat s, uint64_t n) {
+    atomic<uint64_t> &v = statSlot(s);
+    if (n > v.load(memory_order_relaxed)) v.store(n, memory_order_relaxed);
+}
+
+StatsSnapshot statsSnapshot() {
+    ThreadStats::Registry &r = ThreadStats::registry();
+    lock_guard<mutex> g(r.lock);
+    StatsSnapshot out = r.retired;
+    for (const ThreadStats *t : r.live) t->merge(out);
+    return out;
+}
+#else
+inline void statAdd(Stat, uint64_t) {}
+inline void statMax(Stat, uint64_t) {}
+inline StatsSnapshot statsSnapshot() { return {}; }
+#endif
+
+/* One DFA-style scan: `moves` table steps, ended by a dead state or not */
+inline void statScan(size_t moves, bool dead) {
+    statAdd(StatBytesScanned, moves);
+    statAdd(StatDFATransitions, moves);
+    if (dead) statAdd(StatDeadExits, 1);
+}
+
+string statsJSON(const StatsSnapshot &s = statsSnapshot()) {
+    string out = "{";
+    for (uint32_t i = 0; i < NumStats; i++) {
+        if (i) out += ", ";
+        out += string("\"") + STAT_INFO[i].name + "\": " + to_string(s[i]);
+    }
+    return out + "}";
+}
+
+/* Prometheus text exposition format */
+string statsPrometheus(const StatsSnapshot &s = statsSnapshot()) {
+    string out;
+    for (uint32_t i = 0; i < NumStats; i++) {
+        string name = string("searchsystem_") + STAT_INFO[i].name;
+        if (!STAT_INFO[i].isMax) name += "_total";
+        out += "# HELP " + name + " " + STAT_INFO[i].help + "\n";
+        out += "# TYPE " + name + (STAT_INFO[i].isMax ? " gauge\n"
+                                                      : " counter\n");
+        out += name + " " + to_string(s[i]) + "\n";
+    }
+    return out;
+}
+
+/* ====================== NFA ====================== */
+/* Containers allocate from the resource given at construction (the heap
+   by default); a copy-constructed automaton uses the heap. */
+struct NFA {
+    pmr::set<int> states;
+    pmr::set<char> alphabet;
+    pmr::map<int, pmr::map<char, pmr::set<int>>> transitions;
+    pmr::map<int, pmr::set<int>> epsilon;
+    int startState;
+    pmr::set<int> finalStates;
+
+    NFA() = default;
+    explicit NFA(pmr::memory_resource *mr)
+        : states(mr), alphabet(mr), transitions(mr), epsilon(mr),
+          finalStates(mr) {}
+
+    void addTransition(int from, char symbol, int to) {
+        transitions[from][symbol].insert(to);
+    }
+
+    void addEpsilon(int from, int to) {
+        epsilon[from].insert(to);
+    }
+
+    /* Extend a state set with everything reachable over epsilon moves */
+    void epsilonClosure(set<int> &s) const {
+        if (epsilon.empty()) return;
+        vector<int> work(s.begin(), s.end());
+        while (!work.empty()) {
+            int x = work.back(); work.pop_back();
+            auto it = epsilon.find(x);
+            if (it == epsilon.end()) continue;
+            for (int y : it->second)
+                if (s.insert(y).second) work.push_back(y);
+        }
+    }
+
+    /* States reachable from cur on symbol c, epsilon-closed */
+    set<int> move(const set<int> &cur, char c) const {
+        set<int> next;
+        for (int s : cur) {
+            auto row = transitions.find(s);
+            if (row == transitions.end()) continue;
+            auto tos = row->second.find(c);
+            if (tos != row->second.end())
+                next.insert(tos->second.begin(), tos->second.end());
+        }
+        epsilonClosure(next);
+        return next;
+    }
+
+    bool simulate(const string &input) const {
+        set<int> current = {startState};
+        epsilonClosure(current);
+
+        for (size_t i = 0; i < input.size(); i++) {
+            current = move(current, input[i]);
+            if (current.empty()) {
+                statAdd(StatBytesScanned, i + 1);
+                return false;
+            }
+        }
+        statAdd(StatBytesScanned, input.size());
+
+        for (int s : current)
+            if (finalStates.count(s)) return true;
+        return false;
+    }
+
+    void printTransitions() {
+        cout << "\nNFA Transitions:\n";
+        for (auto &[from, mp] : transitions)
+            for (auto &[c, tos] : mp)
+                for (int t : tos)
+                    cout << "  " << from << " --" << c << "--> " << t << "\n";
+        for (auto &[from, tos] : epsilon)
+            for (int t : tos)
+                cout << "  " << from << " --eps--> " << t << "\n";
+
+        cout << "Start: " << startState << "\nFinal: ";
+        for (int f : finalStates) cout << f << " ";
+        cout << "\n";
+    }
+};
+
+/* ====================== Regex → NFA ====================== */
+/* Supported: literals, '.', [...] (ranges, ^ negation), \ escapes
+   (\d \w \s \n \t \r, anything else literal), (...), |, *, +, ?.
+   Parsed into a small AST, then emitted Thompson-style into an NFA. */
+struct RegexNode {
+    enum Kind { Empty, Symbols, Concat, Alt, Star, Plus, Opt } kind;
+    bitset<256> symbols;       /* Symbols */
+    vector<int> children;      /* Concat / Alt: any count, others: one */
+};
+
+class RegexParser {
+public:
+    explicit RegexParser(const string &re) : re(re) {}
+
+    int parse(vector<RegexNode> &out) {
+        nodes = &out;
+        int root = parseAlt();
+        if (pos < re.size())
+            fail(re[pos] == ')' ? "unmatched ')'" : "unexpected character");
+        return root;
+    }
+
+private:
+    const string &re;
+    size_t pos = 0;
+    vector<RegexNode> *nodes = nullptr;
+
+    [[noreturn]] void fail(const string &what) const {
+        throw invalid_argument("regex error at position " +
+                               to_string(pos) + ": " + what);
+    }
+
+    int add(RegexNode::Kind k, vector<int> children = {}) {
+        nodes->push_back({k, {}, move(children)});
+        return nodes->size() - 1;
+    }
+
+    int addSymbols(const bitset<256> &syms) {
+        int n = add(RegexNode::Symbols);
+        (*nodes)[n].symbols = syms;
+        return n;
+    }
+
+    int parseAlt() {
+        vector<int> branches = {parseConcat()};
+        while (pos < re.size() && re[pos] == '|') {
+            pos++;
+            branches.push_back(parseConcat());
+        }
+        return branches.size() == 1 ? branches[0]
+                                    : add(RegexNode::Alt, branches);
+    }
+
+    int parseConcat() {
+        vector<int> parts;
+        while (pos < re.size() && re[pos] != '|' && re[pos] != ')')
+            parts.push_back(parseRepeat());
+        if (parts.empty()) return add(RegexNode::Empty);
+        return parts.size() == 1 ? parts[0] : add(RegexNode::Concat, parts);
+    }
+
+    int parseRepeat() {
+        int n = parseAtom();
+        while (pos < re.size()) {
+            char c = re[pos];
+            if (c == '*')      n = add(RegexNode::Star, {n});
+            else if (c == '+') n = add(RegexNode::Plus, {n});
+            else if (c == '?') n = add(RegexNode::Opt, {n});
+            else break;
+            pos++;
+        }
+        return n;
+    }
+
+    int parseAtom() {
+        char c = re[pos];
+        if (c == '*' || c == '+' || c == '?')
+            fail("nothing to repeat");
+        if (c == '(') {
+            pos++;
+            int n = parseAlt();
+            if (pos >= re.size() || re[pos] != ')') fail("missing ')'");
+            pos++;
+            return n;
+        }
+        if (c == '[') return addSymbols(parseClass());
+
+        bitset<256> syms;
+        if (c == '.') {
+            syms.set();
+            syms.reset('\n');
+            pos++;
+        } else if (c == '\\') {
+            syms = parseEscape();
+        } else {
+            syms.set((unsigned char)c);
+            pos++;
+        }
+        return addSymbols(syms);
+    }
+
+    /* Called with pos on the backslash */
+    bitset<256> parseEscape() {
+        if (++pos >= re.size()) fail("trailing '\\'");
+        char c = re[pos++];
+        bitset<256> syms;
+        switch (c) {
+        case 'd': for (int b = '0'; b <= '9'; b++) syms.set(b); break;
+        case 'w':
+            for (int b = 0; b < 256; b++)
+                if (isalnum(b) || b == '_') syms.set(b);
+            break;
+        case 's': for (char b : string(" \t\n\r\f\v")) syms.set(b); break;
+        case 'n': syms.set('\n'); break;
+        case 't': syms.set('\t'); break;
+        case 'r': syms.set('\r'); break;
+        default:  syms.set((unsigned char)c); break;
+        }
+        return syms;
+    }
+
+    /* Called with pos on '[' */
+    bitset<256> parseClass() {
+        pos++;
+        bool negate = pos < re.size() && re[pos] == '^';
+        if (negate) pos++;
+
+        bitset<256> syms;
+        bool first = true;
+        while (pos < re.size() && (re[pos] != ']' || first)) {
+            first = false;
+            if (re[pos] == '\\') {
+                syms |= parseEscape();
+                continue;
+            }
+            unsigned char lo = re[pos++];
+            if (pos + 1 < re.size() && re[pos] == '-' && re[pos+1] != ']') {
+                unsigned char hi = re[pos+1];
+                if (hi == '\\') fail("escape not allowed as range end");
+                if (hi < lo) fail("invalid range");
+                for (int b = lo; b <= hi; b++) syms.set(b);
+                pos += 2;
+            } else {
+                syms.set(lo);
+            }
+        }
+        if (pos >= re.size()) fail("missing ']'");
+        pos++;
+        if (negate) syms.flip();
+        return syms;
+    }
+};
+
+/* Emits node n starting at state `from`; returns the state it ends in.
+   Loops and optional parts always exit through fresh states, so
+   threading `from` through concatenation keeps plain literals as a
+   simple chain 0 -> 1 -> ... */
+static int emitRegex(NFA &nfa, const vector<RegexNode> &nodes,
+                     int n, int from, int &nextState) {
+    auto fresh = [&]() {
+        nfa.states.insert(nextState);
+        return nextState++;
+    };
+    const RegexNode &node = nodes[n];
+
+    switch (node.kind) {
+    case RegexNode::Empty:
+        return from;
+    case RegexNode::Symbols: {
+        int to = fresh();
+        for (int b = 0; b < 256; b++)
+            if (node.symbols[b]) {
+                nfa.addTransition(from, (char)b, to);
+                nfa.alphabet.insert((char)b);
+            }
+        return to;
+    }
+    case RegexNode::Concat:
+        for (int child : node.children)
+            from = emitRegex(nfa, nodes, child, from, nextState);
+        return from;
+    case RegexNode::Alt: {
+        int join = fresh();
+        for (int child : node.children)
+            nfa.addEpsilon(emitRegex(nfa, nodes, child, from, nextState),
+                           join);
+        return join;
+    }
+    case RegexNode::Star: {
+        int loop = fresh();
+        nfa.addEpsilon(from, loop);
+        int end = emitRegex(nfa, nodes, node.children[0], loop, nextState);
+        nfa.addEpsilon(end, loop);
+        return loop;
+    }
+    case RegexNode::Plus: {
+        int loop = fresh();
+        nfa.addEpsilon(from, loop);
+        int end = emitRegex(nfa, nodes, node.children[0], loop, nextState);
+        int join = fresh();
+        nfa.addEpsilon(end, loop);
+        nfa.addEpsilon(end, join);
+        return join;
+    }
+    case RegexNode::Opt: {
+        /* The body's exit may be a loop state with moves of its own, so
+           the skip path needs a join state the body never leaves from */
+        int end = emitRegex(nfa, nodes, node.children[0], from, nextState);
+        if (end == from) return from;
+        int join = fresh();
+        nfa.addEpsilon(from, join);
+        nfa.addEpsilon(end, join);
+        return join;
+    }
+    }
+    return from;
+}
+
+/* Throws invalid_argument on a malformed pattern */
+NFA regexToNFA(const string &regex,
+               pmr::memory_resource *mr = pmr::get_default_resource()) {
+    vector<RegexNode> nodes;
+    int root = RegexParser(regex).parse(nodes);
+
+    NFA nfa(mr);
+    int next = 1;
+    nfa.startState = 0;
+    nfa.states.insert(0);
+
+    int last = emitRegex(nfa, nodes, root, 0, next);
+    nfa.finalStates.insert(last);
+    return nfa;
+}
+
+/* ====================== DFA ====================== */
+/* Allocates like NFA */
+struct DFA {
+    pmr::set<int> states;
+    pmr::set<char> alphabet;
+    pmr::map<int, pmr::map<char, int>> transitions;
+    int startState;
+    pmr::set<int> finalStates;
+
+    DFA() = default;
+    explicit DFA(pmr::memory_resource *mr)
+        : states(mr), alphabet(mr), transitions(mr), finalStates(mr) {}
+
+    bool simulate(const string &input) const {
+        int current = startState;
+        for (size_t i = 0; i < input.size(); i++) {
+            auto row = transitions.find(current);
+            if (row != transitions.end()) {
+                auto next = row->second.find(input[i]);
+                if (next != row->second.end()) {
+                    current = next->second;
+                    continue;
+                }
+            }
+            statScan(i + 1, true);
+            return false;
+        }
+        statScan(input.size(), false);
+        return finalStates.count(current);
+    }
+
+    void printTransitions() {
+        cout << "\nDFA Transitions:\n";
+        for (auto &[from, mp] : transitions)
+            for (auto &[c, to] : mp)
+                cout << "  " << from << " --" << c << "--> " << to << "\n";
+
+        cout << "States: " << states.size() << "\n";
+        cout << "Start: " << startState << "\nFinal: ";
+        for (int f : finalStates) cout << f << " ";
+        cout << "\n";
+    }
+};
+
+/* ====================== Byte Classes ====================== */
+/* Folds the 256 byte values into equivalence classes: two bytes share a
+   class iff every state sends them to the same place. Patterns over a
+   small alphabet (ACGT) end up with a handful of classes, so table rows
+   shrink from 256 entries to numClasses. */
+struct ByteClasses {
+    array<uint8_t, 256> classOf{};   /* all bytes start in class 0 */
+    uint32_t numClasses = 1;
+
+    /* Split every class by a per-byte key (one row of some automaton) */
+    void refine(const array<int, 256> &key) {
+        map<pair<int, int>, int> ids;
+        for (int b = 0; b < 256; b++) {
+            auto k = make_pair((int)classOf[b], key[b]);
+            auto it = ids.find(k);
+            if (it == ids.end())
+                it = ids.emplace(k, (int)ids.size()).first;
+            classOf[b] = it->second;
+        }
+        numClasses = ids.size();
+    }
+};
+
+ByteClasses computeByteClasses(const DFA &dfa) {
+    ByteClasses bc;
+    for (auto &[from, mp] : dfa.transitions) {
+        array<int, 256> key;
+        key.fill(-1);
+        for (auto &[c, to] : mp) key[(unsigned char)c] = to;
+        bc.refine(key);
+    }
+    return bc;
+}
+
+ByteClasses computeByteClasses(const NFA &nfa) {
+    ByteClasses bc;
+    for (auto &[from, mp] : nfa.transitions) {
+        array<int, 256> key;
+        key.fill(-1);
+        map<pmr::set<int>, int> targetIds;
+        for (auto &[c, tos] : mp) {
+            auto it = targetIds.emplace(tos, (int)targetIds.size()).first;
+            key[(unsigned char)c] = it->second;
+        }
+        bc.refine(key);
+    }
+    return bc;
+}
+
+/* ====================== Subset Construction ====================== */
+/* Read-only copy of an NFA with states renumbered 0..n-1 and transitions
+   flattened per (state, byte class), so subset construction never goes
+   through the NFA's maps. */
+struct DenseNFA {
+    ByteClasses classes;
+    uint32_t numStates = 0;
+    uint32_t start = 0;
+    pmr::vector<uint32_t> moveOffsets;   /* numStates*numClasses + 1 */
+    pmr::vector<uint32_t> moveTargets;
+    pmr::vector<uint32_t> epsOffsets;    /* numStates + 1 */
+    pmr::vector<uint32_t> epsTargets;
+    pmr::vector<char> final;
+
+    explicit DenseNFA(const NFA &nfa,
+                      pmr::memory_resource *mr = pmr::get_default_resource())
+        : classes(computeByteClasses(nfa)), moveOffsets(mr),
+          moveTargets(mr), epsOffsets(mr), epsTargets(mr), final(mr) {
+        pmr::map<int, uint32_t> index(mr);
+        auto id = [&](int s) {
+            auto it = index.emplace(s, (uint32_t)index.size()).first;
+            return it->second;
+        };
+        id(nfa.startState);
+        for (int s : nfa.states) id(s);
+        for (auto &[from, mp] : nfa.transitions) {
+            id(from);
+            for (auto &[c, tos] : mp) for (int t : tos) id(t);
+        }
+        for (auto &[from, tos] : nfa.epsilon) {
+            id(from);
+            for (int t : tos) id(t);
+        }
+        for (int f : nfa.finalStates) id(f);
+
+        numStates = index.size();
+        start = index.at(nfa.startState);
+        final.assign(numStates, 0);
+        for (int f : nfa.finalStates) final[index.at(f)] = 1;
+
+        /* One representative byte per class is enough to read a row */
+        uint32_t nc = classes.numClasses;
+        vector<int> rep(nc, -1);
+        for (int b = 0; b < 256; b++)
+            if (rep[classes.classOf[b]] < 0) rep[classes.classOf[b]] = b;
+
+        moveOffsets.assign((size_t)numStates * nc + 1, 0);
+        epsOffsets.assign(numStates + 1, 0);
+        pmr::vector<const pmr::map<char, pmr::set<int>> *> rows(
+            numStates, nullptr, mr);
+        pmr::vector<const pmr::set<int> *> eps(numStates, nullptr, mr);
+        for (auto &[from, mp] : nfa.transitions) rows[index.at(from)] = &mp;
+        for (auto &[from, tos] : nfa.epsilon) eps[index.at(from)] = &tos;
+
+        for (uint32_t s = 0; s < numStates; s++) {
+            for (uint32_t cls = 0; cls < nc; cls++) {
+                moveOffsets[(size_t)s * nc + cls] = moveTargets.size();
+                if (!rows[s]) continue;
+                auto it = rows[s]->find((char)rep[cls]);
+                if (it == rows[s]->end()) continue;
+                for (int t : it->second) moveTargets.push_back(index.at(t));
+            }
+            epsOffsets[s] = epsTargets.size();
+            if (eps[s])
+                for (int t : *eps[s]) epsTargets.push_back(index.at(t));
+        }
+        moveOffsets.back() = moveTargets.size();
+        epsOffsets.back() = epsTargets.size();
+    }
+};
+
+/* Produces epsilon-closed, sorted subsets; owns the scratch buffers so
+   repeated moves do not allocate once they have grown. */
+class SubsetBuilder {
+public:
+    explicit SubsetBuilder(const DenseNFA &nfa)
+        : nfa(nfa), mark(nfa.numStates, 0) {}
+
+    const vector<uint32_t> &start() {
+        begin();
+        add(nfa.start);
+        return close();
+    }
+
+    const vector<uint32_t> &move(const uint32_t *subset, size_t n,
+                                 uint8_t cls) {
+        begin();
+        uint32_t nc = nfa.classes.numClasses;
+        for (size_t i = 0; i < n; i++) {
+            size_t row = (size_t)subset[i] * nc + cls;
+            for (uint32_t k = nfa.moveOffsets[row];
+                 k < nfa.moveOffsets[row + 1]; k++)
+                add(nfa.moveTargets[k]);
+        }
+        return close();
+    }
+
+    bool accepting(const uint32_t *subset, size_t n) const {
+        for (size_t i = 0; i < n; i++)
+            if (nfa.final[subset[i]]) return true;
+        return false;
+    }
+
+private:
+    const DenseNFA &nfa;
+    vector<uint32_t> mark;   /* mark[s] == stamp  <=>  s already in out */
+    uint32_t stamp = 0;
+    vector<uint32_t> out;
+
+    void begin() {
+        out.clear();
+        if (++stamp == 0) {
+            fill(mark.begin(), mark.end(), 0);
+            stamp = 1;
+        }
+    }
+
+    void add(uint32_t s) {
+        if (mark[s] != stamp) {
+            mark[s] = stamp;
+            out.push_back(s);
+        }
+    }
+
+    const vector<uint32_t> &close() {
+        for (size_t i = 0; i < out.size(); i++) {
+            uint32_t s = out[i];
+            for (uint32_t k = nfa.epsOffsets[s]; k < nfa.epsOffsets[s+1]; k++)
+                add(nfa.epsTargets[k]);
+        }
+        sort(out.begin(), out.end());
+        return out;
+    }
+};
+
+/* Interns sorted subsets: elements live back to back in one vector and
+   are found through an open-addressing table keyed by a cached hash. */
+class SubsetTable {
+public:
+    explicit SubsetTable(
+        pmr::memory_resource *mr = pmr::get_default_resource())
+        : elems(mr), offsets(mr), hashes(mr), slots(mr) {
+        clear();
+    }
+
+    /* Returns (id, true) if the subset was new */
+    pair<uint32_t, bool> intern(const vector<uint32_t> &subset) {
+        uint64_t h = hashOf(subset);
+        size_t i = probe(subset, h);
+        if (slots[i] != EMPTY) return {slots[i], false};
+
+        uint32_t id = hashes.size();
+        slots[i] = id;
+        hashes.push_back(h);
+        elems.insert(elems.end(), subset.begin(), subset.end());
+        offsets.push_back(elems.size());
+        if (hashes.size() * 2 > slots.size()) grow();
+        return {id, true};
+    }
+
+    bool contains(const vector<uint32_t> &subset) const {
+        return slots[probe(subset, hashOf(subset))] != EMPTY;
+    }
+
+    size_t size() const { return hashes.size(); }
+    const uint32_t *data(uint32_t id) const { return &elems[offsets[id]]; }
+    size_t count(uint32_t id) const { return offsets[id+1] - offsets[id]; }
+
+    void clear() {
+        elems.clear();
+        offsets.assign(1, 0);
+        hashes.clear();
+        slots.assign(64, EMPTY);
+    }
+
+private:
+    static constexpr uint32_t EMPTY = 0xFFFFFFFFu;
+    pmr::vector<uint32_t> elems;
+    pmr::vector<size_t> offsets;
+    pmr::vector<uint64_t> hashes;
+    pmr::vector<uint32_t> slots;
+
+    static uint64_t hashOf(const vector<uint32_t> &v) {
+        uint64_t h = 0x9E3779B97F4A7C15ull ^ v.size();
+        for (uint32_t x : v) {
+            h ^= x;
+            h *= 0xFF51AFD7ED558CCDull;
+            h ^= h >> 32;
+        }
+        return h;
+    }
+
+    /* Slot holding subset, or the empty slot where it would go */
+    size_t probe(const vector<uint32_t> &subset, uint64_t h) const {
+        size_t i = h & (slots.size() - 1);
+        while (slots[i] != EMPTY) {
+            uint32_t id = slots[i];
+            if (hashes[id] == h && equal(id, subset)) break;
+            i = (i + 1) & (slots.size() - 1);
+        }
+        return i;
+    }
+
+    bool equal(uint32_t id, const vector<uint32_t> &v) const {
+        return count(id) == v.size() &&
+               std::equal(v.begin(), v.end(), data(id));
+    }
+
+    void grow() {
+        slots.assign(slots.size() * 2, EMPTY);
+        for (uint32_t id = 0; id < hashes.size(); id++) {
+            size_t i = hashes[id] & (slots.size() - 1);
+            while (slots[i] != EMPTY) i = (i + 1) & (slots.size() - 1);
+            slots[i] = id;
+        }
+    }
+};
+
+/* ====================== NFA → DFA ====================== */
+/* The result allocates from mr; the dense NFA and subset table live in a
+   scratch arena that is dropped on return. */
+DFA nfaToDFA(const NFA &nfa,
+             pmr::memory_resource *mr = pmr::get_default_resource()) {
+    auto t0 = chrono::steady_clock::now();
+
+    DFA dfa(mr);
+    dfa.alphabet = nfa.alphabet;
+
+    Arena scratch;
+    DenseNFA dense(nfa, &scratch);
+    SubsetBuilder builder(dense);
+    SubsetTable subsets(&scratch);
+    uint32_t nc = dense.classes.numClasses;
+
+    /* Alphabet symbols grouped by class: one move per class, not per symbol */
+    vector<vector<char>> symbolsOf(nc);
+    for (char c : dfa.alphabet)
+        symbolsOf[dense.classes.classOf[(unsigned char)c]].push_back(c);
+
+    subsets.intern(builder.start());
+    dfa.startState = 0;
+
+    /* Ids are handed out in BFS order, so the id itself is the queue */
+    for (uint32_t cid = 0; cid < subsets.size(); cid++) {
+        dfa.states.insert(cid);
+
+        for (uint32_t cls = 0; cls < nc; cls++) {
+            if (symbolsOf[cls].empty()) continue;
+            auto &next = builder.move(subsets.data(cid), subsets.count(cid),
+                                      cls);
+            if (next.empty()) continue;
+
+            uint32_t nid = subsets.intern(next).first;
+            for (char c : symbolsOf[cls])
+                dfa.transitions[cid][c] = nid;
+        }
+
+        if (builder.accepting(subsets.data(cid), subsets.count(cid)))
+            dfa.finalStates.insert(cid);
+    }
+
+    statAdd(StatNFAToDFACalls, 1);
+    statAdd(StatSubsetStates, subsets.size());
+    statAdd(StatNFAToDFANanos, chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - t0).count());
+    return dfa;
+}
+
+/* ====================== DFA Minimization ====================== */
+struct MinimizeStats {
+    size_t statesBefore = 0;
+    size_t statesAfter = 0;
+};
+
+/* Hopcroft partition refinement over byte classes. Missing transitions
+   go to an implicit sink; states equivalent to the sink (those that can
+   never accept) are dropped along with it, and unreachable states are
+   ignored. States of the result are numbered in BFS order from 0 and
+   allocate from mr. */
+DFA minimizeDFA(const DFA &dfa, MinimizeStats *stats = nullptr,
+                pmr::memory_resource *mr = pmr::get_default_resource()) {
+    ByteClasses bc = computeByteClasses(dfa);
+    uint32_t nc = bc.numClasses;
+
+    /* Reachable states, densely numbered; sink gets id n */
+    Arena scratch;
+    pmr::map<int, uint32_t> index(&scratch);
+    vector<int> original;
+    vector<int> work = {dfa.startState};
+    index[dfa.startState] = 0;
+    original.push_back(dfa.startState);
+    while (!work.empty()) {
+        int s = work.back(); work.pop_back();
+        auto row = dfa.transitions.find(s);
+        if (row == dfa.transitions.end()) continue;
+        for (auto &[c, to] : row->second)
+            if (index.emplace(to, (uint32_t)original.size()).second) {
+                original.push_back(to);
+                work.push_back(to);
+            }
+    }
+    uint32_t n = original.size(), sink = n, total = n + 1;
+
+    vector<uint32_t> delta((size_t)total * nc, sink);
+    for (uint32_t s = 0; s < n; s++) {
+        auto row = dfa.transitions.find(original[s]);
+        if (row == dfa.transitions.end()) continue;
+        for (auto &[c, to] : row->second)
+            delta[(size_t)s * nc + bc.classOf[(unsigned char)c]] = index.at(to);
+    }
+
+    /* Inverse transitions, CSR per (class, target) */
+    vector<uint32_t> invStart((size_t)nc * total + 1, 0), inv(delta.size());
+    for (uint32_t s = 0; s < total; s++)
+        for (uint32_t c = 0; c < nc; c++)
+            invStart[(size_t)c * total + delta[(size_t)s * nc + c] + 1]++;
+    for (size_t i = 1; i < invStart.size(); i++) invStart[i] += invStart[i-1];
+    {
+        vector<uint32_t> fillPos(invStart.begin(), invStart.end() - 1);
+        for (uint32_t s = 0; s < total; s++)
+            for (uint32_t c = 0; c < nc; c++)
+                inv[fillPos[(size_t)c * total + delta[(size_t)s * nc + c]]++] = s;
+    }
+
+    /* Blocks are contiguous ranges of elems; loc[s] is s's index in it */
+    vector<uint32_t> elems(total), loc(total), blockOf(total);
+    vector<uint32_t> first, last, marked;
+    vector<char> inWork;
+    vector<uint32_t> worklist;
+
+    auto isFinal = [&](uint32_t s) {
+        return s < n && dfa.finalStates.count(original[s]);
+    };
+    uint32_t pos = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t begin = pos;
+        for (uint32_t s = 0; s < total; s++)
+            if (isFinal(s) == (pass == 0)) {
+                elems[pos] = s;
+                loc[s] = pos++;
+                blockOf[s] = first.size();
+            }
+        if (pos == begin) continue;
+        first.push_back(begin);
+        last.push_back(pos);
+        marked.push_back(0);
+        inWork.push_back(1);
+        worklist.push_back(first.size() - 1);
+    }
+
+    vector<uint32_t> splitter, touched;
+    while (!worklist.empty()) {
+        uint32_t a = worklist.back(); worklist.pop_back();
+        inWork[a] = 0;
+        splitter.assign(elems.begin() + first[a], elems.begin() + last[a]);
+
+        for (uint32_t c = 0; c < nc; c++) {
+            touched.clear();
+            for (uint32_t q : splitter) {
+                size_t row = (size_t)c * total + q;
+                for (uint32_t k = invStart[row]; k < invStart[row + 1]; k++) {
+                    uint32_t p = inv[k], b = blockOf[p];
+                    if (loc[p] < first[b] + marked[b]) continue;  /* already */
+                    if (marked[b] == 0) touched.push_back(b);
+                    /* Move p to the marked prefix of its block */
+                    uint32_t dst = first[b] + marked[b]++;
+                    uint32_t other = elems[dst];
+                    swap(elems[dst], elems[loc[p]]);
+                    loc[other] = loc[p];
+                    loc[p] = dst;
+                }
+            }
+
+            for (uint32_t b : touched) {
+                uint32_t m = marked[b];
+                marked[b] = 0;
+                if (m == last[b] - first[b]) continue;
+
+                uint32_t nb = first.size();
+                first.push_back(first[b]);
+                last.push_back(first[b] + m);
+                marked.push_back(0);
+                inWork.push_back(0);
+                first[b] += m;
+                for (uint32_t i = first[nb]; i < last[nb]; i++)
+                    blockOf[elems[i]] = nb;
+
+                if (inWork[b] || m < last[b] - first[b]) {
+                    inWork[nb] = 1;
+                    worklist.push_back(nb);
+                } else {
+                    inWork[b] = 1;
+                    worklist.push_back(b);
+                }
+            }
+        }
+    }
+
+    /* Emit blocks in BFS order, skipping the sink's block */
+    DFA out(mr);
+    out.alphabet = dfa.alphabet;
+    out.startState = 0;
+    uint32_t deadBlock = blockOf[sink];
+    vector<int> newId(first.size(), -1);
+    vector<uint32_t> order;
+    if (blockOf[0] != deadBlock) {
+        newId[blockOf[0]] = 0;
+        order.push_back(blockOf[0]);
+    }
+    out.states.insert(0);
+
+    for (size_t i = 0; i < order.size(); i++) {
+        uint32_t b = order[i];
+        uint32_t rep = elems[first[b]];
+        if (isFinal(rep)) out.finalStates.insert(i);
+        for (char c : dfa.alphabet) {
+            uint32_t tb = blockOf[delta[(size_t)rep * nc +
+                                        bc.classOf[(unsigned char)c]]];
+            if (tb == deadBlock) continue;
+            if (newId[tb] < 0) {
+                newId[tb] = order.size();
+                order.push_back(tb);
+                out.states.insert(newId[tb]);
+            }
+            out.transitions[i][c] = newId[tb];
+        }
+    }
+
+    if (stats) {
+        stats->statesBefore = dfa.states.size();
+        stats->statesAfter = out.states.size();
+    }
+    return out;
+}
+
+/* ====================== Lazy DFA ====================== */
+/* Subset construction done on demand while scanning: a DFA state is
+   created only when the input reaches it, and transitions are filled in
+   the first time they are taken. At most maxStates subsets are cached;
+   when the cache is full it is flushed and rebuilt from the current
+   position (as RE2 does), so memory stays bounded on patterns whose
+   full DFA would be exponential. A LazyDFA must not be shared between
+   threads. */
+class LazyDFA {
+public:
+    static constexpr uint32_t UNKNOWN = 0xFFFFFFFFu;
+    static constexpr uint32_t DEAD = 0xFFFFFFFEu;
+
+    explicit LazyDFA(const NFA &nfa, size_t maxStates = 10000)
+        : dense(nfa), builder(dense), maxStates(max<size_t>(maxStates, 2)) {
+        flush();
+        flushes = 0;
+    }
+
+    bool simulate(string_view input) {
+        const uint8_t *cls = dense.classes.classOf.data();
+        uint32_t nc = dense.classes.numClasses;
+        uint32_t s = 0;   /* start state is always cached as 0 */
+        for (size_t i = 0; i < input.size(); i++) {
+            uint8_t c = cls[(unsigned char)input[i]];
+            uint32_t t = trans[(size_t)s * nc + c];
+            if (t == UNKNOWN) t = transition(s, c);
+            if (t == DEAD) {
+                statScan(i + 1, true);
+                return false;
+            }
+            s = t;
+        }
+        statScan(input.size(), false);
+        return final[s];
+    }
+
+    size_t cachedStates() const { return subsets.size(); }
+    size_t flushCount() const { return flushes; }
+
+private:
+    DenseNFA dense;
+    SubsetBuilder builder;
+    size_t maxStates;
+    size_t flushes = 0;
+
+    SubsetTable subsets;
+    vector<uint32_t> trans;   /* cachedStates x numClasses */
+    vector<char> final;
+
+    void flush() {
+        subsets.clear();
+        trans.clear();
+        final.clear();
+        flushes++;
+        intern(builder.start());
+    }
+
+    uint32_t intern(const vector<uint32_t> &subset) {
+        auto [id, added] = subsets.intern(subset);
+        if (added) {
+            statAdd(StatSubsetStates, 1);
+            trans.resize(trans.size() + dense.classes.numClasses, UNKNOWN);
+            final.push_back(builder.accepting(subset.data(), subset.size()));
+        }
+        return id;
+    }
+
+    uint32_t transition(uint32_t s, uint8_t cls) {
+        size_t slot = (size_t)s * dense.classes.numClasses + cls;
+        auto &next = builder.move(subsets.data(s), subsets.count(s), cls);
+        if (next.empty()) return trans[slot] = DEAD;
+
+        if (subsets.size() >= maxStates && !subsets.contains(next)) {
+            /* Drop everything and continue from the target subset; the
+               edge from s is lost with the rest of the cache. next is
+               builder scratch, so it survives the flush only if copied */
+            vector<uint32_t> target(next);
+            flush();
+            return intern(target);
+        }
+        uint32_t id = intern(next);
+        trans[slot] = id;
+        return id;
+    }
+};
+
+/* ====================== Flat DFA ====================== */
+/* Dense table form of a DFA: one row of numClasses entries per state.
+   Missing transitions go to an explicit dead row that loops on itself,
+   so a step is a class lookup plus a single indexed load. The table is
+   read through a plain pointer and kept alive by `storage`, which is
+   either the vector it was built in or a mapped file, so copies are
+   cheap and share the same table. */
+struct FlatDFA {
+    /* numStates+1 rows, last is dead. Ids are 16-bit while every id fits,
+       so exactly one of the two pointers is set. */
+    const uint16_t *table16 = nullptr;
+    const uint32_t *table32 = nullptr;
+    ByteClasses classes;
+    uint32_t stride = 1;         /* row width == classes.numClasses */
+    uint32_t numStates = 0;
+    uint32_t numFinal = 0;       /* states 0..numFinal-1 accept, no others */
+    uint32_t startState = 0;
+    uint32_t deadState = 0;
+    shared_ptr<const void> storage;
+
+    /* Take ownership of a freshly built table; numStates must be set */
+    void adopt(vector<uint32_t> &&t) {
+        if (numStates < 0x10000) {
+            auto owned = make_shared<vector<uint16_t>>(t.begin(), t.end());
+            table16 = owned->data();
+            table32 = nullptr;
+            storage = owned;
+        } else {
+            auto owned = make_shared<vector<uint32_t>>(std::move(t));
+            table32 = owned->data();
+            table16 = nullptr;
+            storage = owned;
+        }
+    }
+
+    /* f(table) with the table's own id type, so hot loops are compiled
+       once per width instead of branching per byte */
+    template <class F>
+    decltype(auto) withTable(F &&f) const {
+        return table16 ? f(table16) : f(table32);
+    }
+
+    size_t idBytes() const { return table16 ? 2 : 4; }
+
+    bool isFinal(uint32_t s) const { return s < numFinal; }
+
+    uint32_t step(uint32_t s, unsigned char c) const {
+        size_t i = (size_t)s * stride + classes.classOf[c];
+        return table16 ? table16[i] : table32[i];
+    }
+
+    /* Bytes held by the table */
+    size_t memoryBytes() const {
+        return (size_t)(numStates + 1) * stride * idBytes();
+    }
+
+    bool simulate(string_view input) const {
+        return withTable([&](auto *t) {
+            const uint8_t *cls = classes.classOf.data();
+            uint32_t s = startState;
+            for (size_t i = 0; i < input.size(); i++) {
+                s = t[(size_t)s * stride + cls[(unsigned char)input[i]]];
+                if (s == deadState) {
+                    statScan(i + 1, true);
+                    return false;
+                }
+            }
+            statScan(input.size(), false);
+            return isFinal(s);
+        });
+    }
+
+    /* End offset of the longest match starting exactly at pos, or npos */
+    size_t longestMatchAt(string_view text, size_t pos) const {
+        return withTable([&](auto *t) {
+            const uint8_t *cls = classes.classOf.data();
+            size_t best = isFinal(startState) ? pos : string_view::npos;
+            uint32_t s = startState;
+            for (size_t i = pos; i < text.size(); i++) {
+                s = t[(size_t)s * stride + cls[(unsigned char)text[i]]];
+                if (s == deadState) break;
+                if (isFinal(s)) best = i + 1;
+            }
+            return best;
+        });
+    }
+};
+
+/* Builds a FlatDFA from a table in any state numbering (numStates+1 rows
+   of classes.numClasses entries, the last row dead). States are
+   renumbered so the accepting ones come first, which makes isFinal one
+   comparison. Within each group they follow BFS order from the start,
+   or hottest first when visit counts are given, so states used together
+   share cache lines. newId, if given, receives each old state's new id
+   (numStates+1 entries, the dead state keeps its id). */
+FlatDFA assembleDFA(const ByteClasses &classes,
+                    const vector<uint32_t> &table,
+                    const vector<bool> &accepting, uint32_t startState,
+                    const vector<uint64_t> *visits = nullptr,
+                    vector<uint32_t> *newId = nullptr) {
+    FlatDFA flat;
+    flat.classes = classes;
+    flat.stride = classes.numClasses;
+    uint32_t n = accepting.size(), stride = flat.stride;
+    flat.numStates = n;
+    flat.deadState = n;
+
+    /* BFS from the start; unreachable states follow in id order */
+    vector<uint32_t> order;
+    order.reserve(n);
+    vector<bool> seen(n + 1, false);
+    seen[n] = true;
+    auto visit = [&](uint32_t s) {
+        if (!seen[s]) {
+            seen[s] = true;
+            order.push_back(s);
+        }
+    };
+    visit(startState);
+    for (size_t h = 0; h < order.size(); h++)
+        for (uint32_t c = 0; c < stride; c++)
+            visit(table[(size_t)order[h] * stride + c]);
+    for (uint32_t s = 0; s < n; s++) visit(s);
+
+    if (visits)
+        stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return (*visits)[a] > (*visits)[b];
+        });
+    auto firstOther = stable_partition(
+        order.begin(), order.end(), [&](uint32_t s) { return accepting[s]; });
+    flat.numFinal = firstOther - order.begin();
+
+    vector<uint32_t> id(n + 1, n);
+    for (uint32_t i = 0; i < n; i++) id[order[i]] = i;
+    vector<uint32_t> out((size_t)(n + 1) * stride, n);
+    for (uint32_t i = 0; i < n; i++)
+        for (uint32_t c = 0; c < stride; c++)
+            out[(size_t)i * stride + c] =
+                id[table[(size_t)order[i] * stride + c]];
+    flat.startState = id[startState];
+    flat.adopt(std::move(out));
+    if (newId) *newId = std::move(id);
+    return flat;
+}
+
+/* With minimize set, the DFA is first reduced by minimizeDFA */
+FlatDFA compileDFA(const DFA &dfa, bool minimize = false) {
+    Arena scratch;
+    if (minimize)
+        return compileDFA(minimizeDFA(dfa, nullptr, &scratch), false);
+
+    /* Renumber states densely; nfaToDFA already uses 0..n-1 */
+    pmr::map<int, uint32_t> index(&scratch);
+    for (int s : dfa.states) {
+        uint32_t id = index.size();
+        index[s] = id;
+    }
+
+    ByteClasses classes = computeByteClasses(dfa);
+    uint32_t stride = classes.numClasses, n = index.size();
+    vector<uint32_t> table((size_t)(n + 1) * stride, n);
+    vector<bool> accepting(n, false);
+
+    for (auto &[from, mp] : dfa.transitions) {
+        auto f = index.find(from);
+        if (f == index.end()) continue;
+        for (auto &[c, to] : mp) {
+            size_t col = classes.classOf[(unsigned char)c];
+            table[(size_t)f->second * stride + col] = index.at(to);
+        }
+    }
+
+    for (int s : dfa.finalStates) {
+        auto f = index.find(s);
+        if (f != index.end()) accepting[f->second] = true;
+    }
+
+    auto st = index.find(dfa.startState);
+    return assembleDFA(classes, table, accepting,
+                       st != index.end() ? st->second : n);
+}
+
+/* Visits per state while running sample through dfa, restarting from the
+   start state whenever the dead state is reached, for reorderDFA */
+vector<uint64_t> profileDFA(const FlatDFA &dfa, string_view sample) {
+    vector<uint64_t> visits(dfa.numStates + 1, 0);
+    uint32_t s = dfa.startState;
+    for (unsigned char c : sample) {
+        s = dfa.step(s, c);
+        if (s == dfa.deadState) s = dfa.startState;
+        visits[s]++;
+    }
+    return visits;
+}
+
+/* Renumbers dfa hottest states first, keeping accepting states first */
+FlatDFA reorderDFA(const FlatDFA &dfa, const vector<uint64_t> &visits) {
+    vector<uint32_t> table((size_t)(dfa.numStates + 1) * dfa.stride);
+    dfa.withTable([&](auto *t) { copy(t, t + table.size(), table.begin()); });
+    vector<bool> accepting(dfa.numStates);
+    for (uint32_t s = 0; s < dfa.numStates; s++)
+        accepting[s] = dfa.isFinal(s);
+    return assembleDFA(dfa.classes, table, accepting, dfa.startState,
+                       &visits);
+}
+
+/* Regex straight to a flat DFA. Every intermediate automaton is built in
+   one arena, so recompiling a pattern leaves no fragmented heap behind. */
+FlatDFA compileRegex(const string &regex, bool minimize = true) {
+    Arena arena;
+    return compileDFA(nfaToDFA(regexToNFA(regex, &arena), &arena), minimize);
+}
+
+/* ====================== Static Literal DFA ====================== */
+/* The DFA that regexToNFA + nfaToDFA give for a plain literal (state i
+   moves to i+1 on pattern[i], everything else is dead, state N accepts),
+   built entirely at compile time. Declared constexpr, the table lands in
+   .rodata and simulate inlines into the caller. Metacharacters are NOT
+   interpreted: the pattern is always a literal. The table is dense and
+   grows with N^2, so patterns are limited to 254 bytes, which also lets
+   every state id fit in one byte. */
+template <size_t N>
+struct StaticDFA {
+    static_assert(N < 255, "static literal patterns are limited to 254 bytes");
+    static constexpr uint32_t deadState = N + 1;
+
+    array<uint8_t, 256> classOf{};
+    uint32_t numClasses = 1;      /* row width; class 0 = not in pattern */
+    array<uint8_t, (N + 2) * (N + 1)> table{};
+
+    constexpr bool simulate(string_view input) const {
+        uint32_t s = 0;
+        for (char c : input) {
+            s = table[s * numClasses + classOf[(unsigned char)c]];
+            if (s == deadState) return false;
+        }
+        return s == N;
+    }
+};
+
+template <size_t N>
+constexpr StaticDFA<N> buildStaticDFA(const char *pattern) {
+    StaticDFA<N> dfa;
+    for (size_t i = 0; i < N; i++) {
+        unsigned char c = pattern[i];
+        if (dfa.classOf[c] == 0) dfa.classOf[c] = dfa.numClasses++;
+    }
+    for (auto &t : dfa.table) t = StaticDFA<N>::deadState;
+    for (size_t i = 0; i < N; i++)
+        dfa.table[i * dfa.numClasses + dfa.classOf[(unsigned char)pattern[i]]]
+            = i + 1;
+    return dfa;
+}
+
+/* constexpr auto primer = makeStaticDFA("ACGTTGCA"); */
+template <size_t L>
+constexpr StaticDFA<L - 1> makeStaticDFA(const char (&pattern)[L]) {
+    return buildStaticDFA<L - 1>(pattern);
+}
+
+/* Templated on the pattern itself:
+     static constexpr char PRIMER[] = "ACGTTGCA";
+     StaticLiteral<PRIMER>::simulate(read);  */
+template <const char *Pattern>
+struct StaticLiteral {
+    static constexpr size_t length = char_traits<char>::length(Pattern);
+    static constexpr StaticDFA<length> dfa = buildStaticDFA<length>(Pattern);
+
+    static constexpr bool simulate(string_view input) {
+        return dfa.simulate(input);
+    }
+};
+
+/* ====================== Literal Prefilter ====================== */
+/* Skips input bytes that cannot start a match. Built from one DFA state:
+   the bytes whose transition leaves it for something other than `idle`
+   (the dead state for anchored use, the state itself for a self-looping
+   search start). With at most three such bytes the scan is a vectorized
+   memchr; when the first two steps are forced literals (and no match is
+   one byte long) both bytes are checked together. The vector width is
+   picked at runtime (AVX2 / SSE2 / NEON / scalar). */
+struct Prefilter {
+    enum Kind { All, Bytes, Pair } kind = All;
+    uint8_t needle[3] = {0, 0, 0};   /* Bytes: unused slots repeat [0] */
+    int count = 0;
+
+    /* First candidate position in [p, end), or end */
+    const char *find(const char *p, const char *end) const;
+};
+
+Prefilter buildPrefilter(const FlatDFA &dfa, uint32_t state, uint32_t idle) {
+    Prefilter pf;
+    if (state == dfa.deadState || dfa.isFinal(state)) return pf;
+
+    vector<uint8_t> bytes;
+    for (int b = 0; b < 256; b++)
+        if (dfa.step(state, b) != idle) bytes.push_back(b);
+    if (bytes.empty() || bytes.size() > 3) return pf;
+
+    pf.kind = Prefilter::Bytes;
+    pf.count = bytes.size();
+    for (int i = 0; i < 3; i++)
+        pf.needle[i] = bytes[min<int>(i, bytes.size() - 1)];
+
+    if (bytes.size() == 1 && idle == dfa.deadState) {
+        uint32_t s1 = dfa.step(state, bytes[0]);
+        vector<uint8_t> second;
+        for (int b = 0; b < 256 && second.size() < 2; b++)
+            if (dfa.step(s1, b) != dfa.deadState) second.push_back(b);
+        if (second.size() == 1 && !dfa.isFinal(s1)) {
+            pf.kind = Prefilter::Pair;
+            pf.needle[1] = second[0];
+        }
+    }
+    return pf;
+}
+
+typedef const char *(*PrefilterFn)(const Prefilter &, const char *,
+                                   const char *);
+
+static const char *prefilterScalar(const Prefilter &pf, const char *p,
+                                   const char *end) {
+    const uint8_t *n = pf.needle;
+    if (pf.kind == Prefilter::Pair) {
+        for (; p + 1 < end; p++) {
+            p = static_cast<const char *>(memchr(p, n[0], end - 1 - p));
+            if (!p) return end;
+            if ((uint8_t)p[1] == n[1]) return p;
+        }
+        return end;
+    }
+    if (pf.count == 1) {
+        const void *hit = memchr(p, n[0], end - p);
+        return hit ? static_cast<const char *>(hit) : end;
+    }
+    for (; p < end; p++) {
+        uint8_t c = *p;
+        if (c == n[0] || c == n[1] || c == n[2]) return p;
+    }
+    return end;
+}
+
+#ifdef SEARCHSYSTEM_SSE2
+static const char *prefilterSSE2(const Prefilter &pf, const char *p,
+                                 const char *end) {
+    const uint8_t *n = pf.needle;
+    __m128i n0 = _mm_set1_epi8(n[0]), n1 = _mm_set1_epi8(n[1]),
+            n2 = _mm_set1_epi8(n[2]);
+    bool pair = pf.kind == Prefilter::Pair;
+    /* Pair reads one byte past each block, so stop a byte earlier */
+    const char *limit = end - pair;
+    for (; p + 16 <= limit; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i eq;
+        if (pair) {
+            __m128i w = _mm_loadu_si128((const __m128i *)(p + 1));
+            eq = _mm_and_si128(_mm_cmpeq_epi8(v, n0), _mm_cmpeq_epi8(w, n1));
+        } else {
+            eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, n0),
+                                           _mm_cmpeq_epi8(v, n1)),
+                              _mm_cmpeq_epi8(v, n2));
+        }
+        int mask = _mm_movemask_epi8(eq);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return prefilterScalar(pf, p, end);
+}
+#endif
+
+#ifdef SEARCHSYSTEM_AVX2
+__attribute__((target("avx2")))
+static const char *prefilterAVX2(const Prefilter &pf, const char *p,
+                                 const char *end) {
+    const uint8_t *n = pf.needle;
+    __m256i n0 = _mm256_set1_epi8(n[0]), n1 = _mm256_set1_epi8(n[1]),
+            n2 = _mm256_set1_epi8(n[2]);
+    bool pair = pf.kind == Prefilter::Pair;
+    const char *limit = end - pair;
+    for (; p + 32 <= limit; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i eq;
+        if (pair) {
+            __m256i w = _mm256_loadu_si256((const __m256i *)(p + 1));
+            eq = _mm256_and_si256(_mm256_cmpeq_epi8(v, n0),
+                                  _mm256_cmpeq_epi8(w, n1));
+        } else {
+            eq = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, n0),
+                                                 _mm256_cmpeq_epi8(v, n1)),
+                                 _mm256_cmpeq_epi8(v, n2));
+        }
+        unsigned mask = _mm256_movemask_epi8(eq);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return prefilterSSE2(pf, p, end);
+}
+#endif
+
+#ifdef SEARCHSYSTEM_NEON
+static const char *prefilterNEON(const Prefilter &pf, const char *p,
+                                 const char *end) {
+    const uint8_t *n = pf.needle;
+    uint8x16_t n0 = vdupq_n_u8(n[0]), n1 = vdupq_n_u8(n[1]),
+               n2 = vdupq_n_u8(n[2]);
+    bool pair = pf.kind == Prefilter::Pair;
+    const char *limit = end - pair;
+    for (; p + 16 <= limit; p += 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)p);
+        uint8x16_t eq;
+        if (pair) {
+            uint8x16_t w = vld1q_u8((const uint8_t *)p + 1);
+            eq = vandq_u8(vceqq_u8(v, n0), vceqq_u8(w, n1));
+        } else {
+            eq = vorrq_u8(vorrq_u8(vceqq_u8(v, n0), vceqq_u8(v, n1)),
+                          vceqq_u8(v, n2));
+        }
+        /* Narrow to 4 bits per lane to get a 64-bit hit mask */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (mask) return p + __builtin_ctzll(mask) / 4;
+    }
+    return prefilterScalar(pf, p, end);
+}
+#endif
+
+static PrefilterFn choosePrefilter() {
+#ifdef SEARCHSYSTEM_AVX2
+    if (__builtin_cpu_supports("avx2")) return prefilterAVX2;
+#endif
+#ifdef SEARCHSYSTEM_SSE2
+    return prefilterSSE2;
+#elif defined(SEARCHSYSTEM_NEON)
+    return prefilterNEON;
+#else
+    return prefilterScalar;
+#endif
+}
+
+const char *Prefilter::find(const char *p, const char *end) const {
+    static const PrefilterFn impl = choosePrefilter();
+    if (kind == All || p >= end) return p;
+    return impl(*this, p, end);
+}
+
+/* Runs the DFA anchored at every candidate start the prefilter lets
+   through; onMatch(start, end) gets the longest match for each start
+   that has one. Returns the number of matches. */
+template <class F>
+size_t scanCandidates(const FlatDFA &dfa, const Prefilter &pf,
+                      string_view text, F &&onMatch) {
+    const char *base = text.data(), *end = base + text.size();
+    size_t matches = 0;
+    for (const char *p = base; ; p++) {
+        p = pf.find(p, end);
+        size_t start = p - base;
+        size_t stop = dfa.longestMatchAt(text, start);
+        if (stop != string_view::npos) {
+            matches++;
+            onMatch(start, stop);
+        }
+        if (p >= end) break;
+    }
+    return matches;
+}
+
+/* ====================== Unanchored Search ====================== */
+struct Match {
+    size_t start, end;   /* text[start, end) */
+};
+
+/* One id above every state the NFA mentions */
+static int freshState(const NFA &nfa) {
+    int top = nfa.startState;
+    if (!nfa.states.empty()) top = max(top, *nfa.states.rbegin());
+    for (auto &[from, mp] : nfa.transitions) {
+        top = max(top, from);
+        for (auto &[c, tos] : mp) top = max(top, *tos.rbegin());
+    }
+    for (auto &[from, tos] : nfa.epsilon) top = max({top, from, *tos.rbegin()});
+    for (int f : nfa.finalStates) top = max(top, f);
+    return top + 1;
+}
+
+/* Same language behind an implicit ".*": a new start state loops on
+   every byte and falls through into the old start */
+NFA unanchoredNFA(const NFA &nfa) {
+    NFA out = nfa;
+    int s = freshState(nfa);
+    out.states.insert(s);
+    for (int b = 0; b < 256; b++) {
+        out.addTransition(s, (char)b, s);
+        out.alphabet.insert((char)b);
+    }
+    out.addEpsilon(s, nfa.startState);
+    out.startState = s;
+    return out;
+}
+
+/* Accepts exactly the reversed strings of nfa's language */
+NFA reverseNFA(const NFA &nfa) {
+    NFA out;
+    out.alphabet = nfa.alphabet;
+    out.states = nfa.states;
+    for (auto &[from, mp] : nfa.transitions)
+        for (auto &[c, tos] : mp)
+            for (int t : tos) out.addTransition(t, c, from);
+    for (auto &[from, tos] : nfa.epsilon)
+        for (int t : tos) out.addEpsilon(t, from);
+
+    int s = freshState(nfa);
+    out.states.insert(s);
+    out.startState = s;
+    for (int f : nfa.finalStates) out.addEpsilon(s, f);
+    out.finalStates.insert(nfa.startState);
+    return out;
+}
+
+/* Finds the leftmost-longest matches of an automaton in a text: the
+   match that starts first, extended as far as it goes, then the same
+   again after its end. A match starts at s iff the reversed DFA behind
+   an implicit ".*" accepts text[s, n) read backwards, so one backward
+   pass marks every start; the anchored DFA then extends a start to its
+   longest match. The forward unanchored DFA, behind the literal
+   prefilter, first checks that anything matches at all, so texts with
+   no match are never read backwards. Matches do not overlap; after an
+   empty match the scan resumes one byte later. */
+class Searcher {
+public:
+    explicit Searcher(const NFA &nfa)
+        : anchored(compileDFA(nfaToDFA(nfa), true)),
+          forward(compileDFA(nfaToDFA(unanchoredNFA(nfa)), true)),
+          reverse(compileDFA(nfaToDFA(unanchoredNFA(reverseNFA(nfa))), true)),
+          prefilter(buildPrefilter(forward, forward.startState,
+                                   forward.startState)) {}
+
+    /* Leftmost-longest match starting at or after `from` */
+    bool findFirst(string_view text, Match &m, size_t from = 0) const {
+        if (from > text.size() ||
+            firstEnd(text, from) == string_view::npos)
+            return false;
+
+        /* Leftmost start: the last accepting point of a backward pass */
+        size_t start = string_view::npos;
+        uint32_t r = reverse.startState;
+        if (reverse.isFinal(r)) start = text.size();
+        for (size_t j = text.size(); j > from; j--) {
+            r = reverse.step(r, text[j-1]);
+            if (reverse.isFinal(r)) start = j - 1;
+        }
+
+        m.start = start;
+        m.end = anchored.longestMatchAt(text, start);
+        return true;
+    }
+
+    /* onMatch(const Match &) for every match, left to right; returns the
+       number of matches. The backward pass runs once to record its
+       state at each block boundary, then again one block at a time as
+       the forward walk reaches it, so each byte is read at most twice
+       backwards and only one block of start marks is held. A text of
+       one block is read backwards once. */
+    template <class F>
+    size_t forEach(string_view text, F &&onMatch) const {
+        statAdd(StatBytesScanned, text.size());
+        if (firstEnd(text, 0) == string_view::npos) return 0;
+
+        /* Block k holds starts in [k*BLOCK, (k+1)*BLOCK), the last one
+           also the empty suffix at n; entry[k] is the backward state
+           after reading everything to the right of block k */
+        size_t n = text.size(), blocks = n / BLOCK + 1;
+        const uint8_t *in = (const uint8_t *)text.data();
+        const uint8_t *cls = reverse.classes.classOf.data();
+        uint32_t stride = reverse.stride, numFinal = reverse.numFinal;
+        vector<uint32_t> entry(blocks);
+        vector<uint64_t> starts(BLOCK / 64);
+
+        reverse.withTable([&](auto *t) {
+            uint32_t r = reverse.startState;
+            for (size_t k = blocks - 1; k > 0; k--) {
+                entry[k] = r;
+                for (size_t j = min((k + 1) * BLOCK, n); j > k * BLOCK; j--)
+                    r = t[(size_t)r * stride + cls[in[j-1]]];
+            }
+            entry[0] = r;
+        });
+        auto mark = [&](size_t k) {
+            fill(starts.begin(), starts.end(), 0);
+            size_t lo = k * BLOCK, top = min(lo + BLOCK, n);
+            uint32_t r = entry[k];
+            if (top == n && n < lo + BLOCK && r < numFinal)
+                starts[(n - lo) >> 6] |= uint64_t(1) << ((n - lo) & 63);
+            reverse.withTable([&](auto *t) {
+                for (size_t j = top; j > lo; j--) {
+                    r = t[(size_t)r * stride + cls[in[j-1]]];
+                    size_t i = j - 1 - lo;
+                    starts[i >> 6] |= uint64_t(r < numFinal) << (i & 63);
+                }
+            });
+        };
+
+        size_t count = 0, pos = 0, marked = SIZE_MAX;
+        while (pos <= n) {
+            size_t k = pos / BLOCK, i = pos % BLOCK;
+            if (k != marked) mark(marked = k);
+            size_t w = i >> 6;
+            uint64_t bits = starts[w] & (~uint64_t(0) << (i & 63));
+            while (!bits && ++w < starts.size()) bits = starts[w];
+            if (!bits) {
+                pos = (k + 1) * BLOCK;
+                continue;
+            }
+            Match m;
+            m.start = k * BLOCK + w * 64 + __builtin_ctzll(bits);
+            m.end = anchored.longestMatchAt(text, m.start);
+            count++;
+            onMatch(m);
+            pos = m.end > m.start ? m.end : m.end + 1;
+        }
+        return count;
+    }
+
+    vector<Match> findAll(string_view text) const {
+        vector<Match> out;
+        forEach(text, [&](const Match &m) { out.push_back(m); });
+        return out;
+    }
+
+    size_t count(string_view text) const {
+        return forEach(text, [](const Match &) {});
+    }
+
+    size_t memoryBytes() const {
+        return anchored.memoryBytes() + forward.memoryBytes() +
+               reverse.memoryBytes();
+    }
+
+private:
+    static constexpr size_t BLOCK = 1 << 16;
+
+    FlatDFA anchored, forward, reverse;
+    Prefilter prefilter;
+
+    /* Earliest end of a match lying in text[from, n), or npos */
+    size_t firstEnd(string_view text, size_t from) const {
+        uint32_t s = forward.startState;
+        if (forward.isFinal(s)) return from;
+        const char *base = text.data(), *stop = base + text.size();
+        for (const char *p = base + from; ; p++) {
+            if (s == forward.startState) p = prefilter.find(p, stop);
+            if (p >= stop) return string_view::npos;
+            s = forward.step(s, *p);
+            if (forward.isFinal(s)) return p + 1 - base;
+        }
+    }
+};
+
+/* ====================== Aho-Corasick ====================== */
+/* Many literal patterns merged into one trie whose failure links are
+   folded into a complete FlatDFA, so one pass over the text finds every
+   occurrence of every pattern. The start state is the root and the dead
+   row is never reached. A state is final iff some pattern ends there;
+   ownStart/ownIds list the patterns ending exactly at a state and
+   outLink points to the nearest proper suffix state that also ends one.
+   Empty patterns are ignored. */
+struct AhoCorasick {
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    FlatDFA dfa;
+    vector<uint32_t> ownStart;       /* numStates + 1 */
+    vector<uint32_t> ownIds;
+    vector<uint32_t> outLink;
+    vector<uint32_t> patternLength;
+
+    /* onHit(uint32_t patternId, size_t startOffset), in order of end
+       position */
+    template <class F>
+    void search(string_view text, F &&onHit) const {
+        statScan(text.size(), false);
+        dfa.withTable([&](auto *t) {
+            const uint8_t *cls = dfa.classes.classOf.data();
+            uint32_t s = dfa.startState;
+            for (size_t i = 0; i < text.size(); i++) {
+                s = t[(size_t)s * dfa.stride + cls[(unsigned char)text[i]]];
+                if (!dfa.isFinal(s)) continue;
+                for (uint32_t o = s; o != NONE; o = outLink[o])
+                    for (uint32_t k = ownStart[o]; k < ownStart[o+1]; k++)
+                        onHit(ownIds[k], i + 1 - patternLength[ownIds[k]]);
+            }
+        });
+    }
+};
+
+AhoCorasick buildAhoCorasick(const vector<string> &patterns) {
+    const uint32_t NONE = AhoCorasick::NONE;
+    AhoCorasick ac;
+    FlatDFA &dfa = ac.dfa;
+
+    /* Every byte that occurs in a pattern gets its own class; all other
+       bytes share one class that always leads back to the root */
+    array<int, 256> key{};
+    for (auto &p : patterns)
+        for (unsigned char c : p) key[c] = c + 1;
+    dfa.classes.refine(key);
+    dfa.stride = dfa.classes.numClasses;
+
+    /* Trie, with NONE for missing edges */
+    vector<uint32_t> go(dfa.stride, NONE);
+    vector<vector<uint32_t>> own(1);
+    for (uint32_t id = 0; id < patterns.size(); id++) {
+        if (patterns[id].empty()) continue;
+        uint32_t s = 0;
+        for (unsigned char c : patterns[id]) {
+            uint32_t &next = go[(size_t)s * dfa.stride + dfa.classes.classOf[c]];
+            if (next == NONE) {
+                next = own.size();
+                own.emplace_back();
+                go.resize(go.size() + dfa.stride, NONE);
+            }
+            s = go[(size_t)s * dfa.stride + dfa.classes.classOf[c]];
+        }
+        own[s].push_back(id);
+    }
+
+    uint32_t n = own.size();
+    vector<uint32_t> fail(n, 0);
+    ac.outLink.assign(n, NONE);
+
+    /* BFS: fill missing edges from the failure state's row */
+    queue<uint32_t> q;
+    for (uint32_t c = 0; c < dfa.stride; c++) {
+        uint32_t &t = go[c];
+        if (t == NONE) t = 0;
+        else q.push(t);
+    }
+    while (!q.empty()) {
+        uint32_t s = q.front(); q.pop();
+        uint32_t f = fail[s];
+        ac.outLink[s] = !own[f].empty() ? f : ac.outLink[f];
+        for (uint32_t c = 0; c < dfa.stride; c++) {
+            uint32_t &t = go[(size_t)s * dfa.stride + c];
+            uint32_t viaFail = go[(size_t)f * dfa.stride + c];
+            if (t == NONE) {
+                t = viaFail;
+            } else {
+                fail[t] = viaFail;
+                q.push(t);
+            }
+        }
+    }
+
+    go.resize((size_t)(n + 1) * dfa.stride, n);
+    vector<bool> accepting(n);
+    for (uint32_t s = 0; s < n; s++)
+        accepting[s] = !own[s].empty() || ac.outLink[s] != NONE;
+    vector<uint32_t> id;
+    dfa = assembleDFA(dfa.classes, go, accepting, 0, nullptr, &id);
+
+    /* Per-state lists in the new numbering */
+    vector<uint32_t> oldOf(n), outLink(n);
+    for (uint32_t s = 0; s < n; s++) oldOf[id[s]] = s;
+    ac.ownStart.assign(n + 1, 0);
+    for (uint32_t s = 0; s < n; s++) {
+        uint32_t o = oldOf[s];
+        ac.ownStart[s] = ac.ownIds.size();
+        ac.ownIds.insert(ac.ownIds.end(), own[o].begin(), own[o].end());
+        outLink[s] = ac.outLink[o] == NONE ? NONE : id[ac.outLink[o]];
+    }
+    ac.ownStart[n] = ac.ownIds.size();
+    ac.outLink.swap(outLink);
+
+    for (auto &p : patterns) ac.patternLength.push_back(p.size());
+    return ac;
+}
+
+/* ====================== Thread Pool ====================== */
+/* Fixed set of worker threads. parallelFor must not be called from
+   inside one of the pool's own tasks. */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = thread::hardware_concurrency()) {
+        for (size_t i = 0; i < threads; i++)
+            workers.emplace_back([this] { work(); });
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(mu);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto &w : workers) w.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    /* Runs fn(i) for every i in [0, count) and waits for all of them */
+    void parallelFor(size_t count, const function<void(size_t)> &fn) {
+        if (workers.empty() || count <= 1) {
+            for (size_t i = 0; i < count; i++) fn(i);
+            return;
+        }
+
+        mutex doneMu;
+        condition_variable doneCv;
+        size_t remaining = count;
+        {
+            lock_guard<mutex> lock(mu);
+            for (size_t i = 0; i < count; i++)
+                tasks.push([&, i] {
+                    fn(i);
+                    lock_guard<mutex> done(doneMu);
+                    if (--remaining == 0) doneCv.notify_one();
+                });
+        }
+        cv.notify_all();
+
+        unique_lock<mutex> lock(doneMu);
+        doneCv.wait(lock, [&] { return remaining == 0; });
+    }
+
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex mu;
+    condition_variable cv;
+    bool stopping = false;
+
+    void work() {
+        for (;;) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(mu);
+                cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+};
+
+/* ====================== Parallel DFA Scan ====================== */
+/* Computes, for every state o, the state reached by running chunk from
+   o. All states run side by side as "lanes"; every 64 bytes lanes that
+   have reached the same state are merged and dead lanes dropped, so for
+   most automata the work collapses to a single lane within a few
+   blocks. */
+template <class Id>
+static void flatChunkMap(const FlatDFA &dfa, const Id *t, string_view chunk,
+                         vector<uint32_t> &endOf) {
+    const uint8_t *cls = dfa.classes.classOf.data();
+    const uint32_t DEADLANE = 0xFFFFFFFFu;
+
+    vector<uint32_t> cur(dfa.numStates), laneOf(dfa.numStates);
+    for (uint32_t o = 0; o < dfa.numStates; o++) cur[o] = laneOf[o] = o;
+    vector<uint32_t> remap(dfa.numStates + 1, DEADLANE);
+    vector<uint32_t> merged;
+
+    size_t i = 0, n = chunk.size();
+    while (i < n && cur.size() > 1) {
+        size_t blockEnd = min(n, i + 64);
+        for (; i < blockEnd; i++) {
+            uint32_t cl = cls[(unsigned char)chunk[i]];
+            for (uint32_t &s : cur) s = t[(size_t)s * dfa.stride + cl];
+        }
+
+        /* Merge lanes that now share a state */
+        merged.clear();
+        for (uint32_t s : cur)
+            if (s != dfa.deadState && remap[s] == DEADLANE) {
+                remap[s] = merged.size();
+                merged.push_back(s);
+            }
+        for (uint32_t &l : laneOf)
+            if (l != DEADLANE) l = remap[cur[l]];
+        for (uint32_t s : merged) remap[s] = DEADLANE;
+        cur.swap(merged);
+    }
+
+    if (cur.size() == 1) {
+        uint32_t s = cur[0];
+        for (; i < n && s != dfa.deadState; i++)
+            s = t[(size_t)s * dfa.stride + cls[(unsigned char)chunk[i]]];
+        cur[0] = s;
+    }
+
+    endOf.resize(dfa.numStates + 1);
+    for (uint32_t o = 0; o < dfa.numStates; o++)
+        endOf[o] = laneOf[o] == DEADLANE ? dfa.deadState : cur[laneOf[o]];
+    endOf[dfa.deadState] = dfa.deadState;
+}
+
+/* Same answer as dfa.simulate(input). The input is cut into chunkSize
+   pieces; the first runs from the start state, every other one computes
+   a full state -> state map, and the maps are composed in order. */
+bool parallelSimulate(const FlatDFA &dfa, string_view input,
+                      ThreadPool &pool, size_t chunkSize = 1 << 20) {
+    chunkSize = max<size_t>(chunkSize, 1);
+    size_t chunks = (input.size() + chunkSize - 1) / chunkSize;
+    if (chunks <= 1 || pool.size() <= 1) return dfa.simulate(input);
+
+    uint32_t first = dfa.startState;
+    vector<vector<uint32_t>> maps(chunks);
+    pool.parallelFor(chunks, [&](size_t c) {
+        string_view piece = input.substr(c * chunkSize, chunkSize);
+        statScan(piece.size(), false);
+        if (c > 0) {
+            dfa.withTable([&](auto *t) {
+                flatChunkMap(dfa, t, piece, maps[c]);
+            });
+            return;
+        }
+        uint32_t s = dfa.startState;
+        for (unsigned char ch : piece) {
+            s = dfa.step(s, ch);
+            if (s == dfa.deadState) break;
+        }
+        first = s;
+    });
+
+    uint32_t s = first;
+    for (size_t c = 1; c < chunks && s != dfa.deadState; c++)
+        s = maps[c][s];
+    return s != dfa.deadState && dfa.isFinal(s);
+}
+
+/* ====================== Batch Matching ====================== */
+/* Many short strings against one flat DFA. Strings are run four at a
+   time in lockstep so the four independent table loads overlap instead
+   of each string waiting on its own load chain. Results are a bitmap:
+   bit i of out[i / 64] is set iff string i is accepted. */
+template <class Id, class Get>
+static void batchLanes(const FlatDFA &dfa, const Id *t, Get &&item,
+                       size_t begin, size_t end, uint64_t *out) {
+    const uint8_t *cls = dfa.classes.classOf.data();
+    auto finish = [&](uint32_t s, string_view rest) {
+        for (unsigned char c : rest) {
+            if (s == dfa.deadState) break;
+            s = t[(size_t)s * dfa.stride + cls[c]];
+        }
+        return s != dfa.deadState && dfa.isFinal(s);
+    };
+    auto setBit = [&](size_t i, bool v) {
+        if (v) out[i >> 6] |= uint64_t(1) << (i & 63);
+        else out[i >> 6] &= ~(uint64_t(1) << (i & 63));
+    };
+
+    size_t i = begin, bytes = 0;
+    for (; i + 4 <= end; i += 4) {
+        string_view a = item(i), b = item(i+1), c = item(i+2), d = item(i+3);
+        size_t common = min({a.size(), b.size(), c.size(), d.size()});
+        bytes += a.size() + b.size() + c.size() + d.size();
+        uint32_t sa = dfa.startState, sb = sa, sc = sa, sd = sa;
+        /* The dead row loops on itself, so no checks are needed here */
+        for (size_t k = 0; k < common; k++) {
+            sa = t[(size_t)sa * dfa.stride + cls[(unsigned char)a[k]]];
+            sb = t[(size_t)sb * dfa.stride + cls[(unsigned char)b[k]]];
+            sc = t[(size_t)sc * dfa.stride + cls[(unsigned char)c[k]]];
+            sd = t[(size_t)sd * dfa.stride + cls[(unsigned char)d[k]]];
+        }
+        setBit(i,   finish(sa, a.substr(common)));
+        setBit(i+1, finish(sb, b.substr(common)));
+        setBit(i+2, finish(sc, c.substr(common)));
+        setBit(i+3, finish(sd, d.substr(common)));
+    }
+    for (; i < end; i++) {
+        bytes += item(i).size();
+        setBit(i, finish(dfa.startState, item(i)));
+    }
+    statScan(bytes, false);
+}
+
+template <class Get>
+static void batchRange(const FlatDFA &dfa, Get &&item, size_t begin,
+                       size_t end, uint64_t *out) {
+    dfa.withTable([&](auto *t) {
+        batchLanes(dfa, t, item, begin, end, out);
+    });
+}
+
+vector<uint64_t> batchSimulate(const FlatDFA &dfa,
+                               const vector<string_view> &items) {
+    vector<uint64_t> out((items.size() + 63) / 64, 0);
+    batchRange(dfa, [&](size_t i) { return items[i]; }, 0, items.size(),
+               out.data());
+    return out;
+}
+
+/* Packed form: string i is bytes[offsets[i], offsets[i+1]) */
+vector<uint64_t> batchSimulate(const FlatDFA &dfa, const char *bytes,
+                               const uint32_t *offsets, size_t count) {
+    vector<uint64_t> out((count + 63) / 64, 0);
+    batchRange(dfa, [&](size_t i) {
+        return string_view(bytes + offsets[i], offsets[i+1] - offsets[i]);
+    }, 0, count, out.data());
+    return out;
+}
+
+/* Splits the batch into groups of `grain` strings (rounded up to a
+   multiple of 64 so tasks never share an output word) */
+vector<uint64_t> batchSimulate(const FlatDFA &dfa,
+                               const vector<string_view> &items,
+                               ThreadPool &pool, size_t grain = 1 << 14) {
+    grain = max<size_t>((grain + 63) / 64 * 64, 64);
+    vector<uint64_t> out((items.size() + 63) / 64, 0);
+    size_t tasks = (items.size() + grain - 1) / grain;
+    pool.parallelFor(tasks, [&](size_t k) {
+        batchRange(dfa, [&](size_t i) { return items[i]; }, k * grain,
+                   min(items.size(), (k + 1) * grain), out.data());
+    });
+    return out;
+}
+
+/* ====================== Bit-parallel NFA ====================== */
+/* Position automaton (Glushkov style) over bitsets. Each position is one
+   NFA edge group (from -> to on some set of bytes); a position is active
+   when its source state is in the current epsilon-closed set. One extra
+   position, finalPos, has no labels and is active iff the set accepts.
+   A step is: fired = active & symMask[class], next = OR of follow[p]
+   over fired p; no allocation happens per byte. */
+struct BitNFA {
+    ByteClasses classes;
+    uint32_t numPositions = 0;   /* edges + 1 (finalPos) */
+    uint32_t words = 0;          /* uint64_t words per state set */
+    uint32_t finalPos = 0;
+    vector<uint64_t> startMask;  /* words */
+    vector<uint64_t> symMask;    /* numClasses x words */
+    vector<uint64_t> follow;     /* numPositions x words */
+
+    static bool test(const uint64_t *m, uint32_t p) {
+        return (m[p >> 6] >> (p & 63)) & 1;
+    }
+
+    /* next = positions reachable by reading a byte of class cls from cur;
+       returns false if next is empty */
+    bool step(const uint64_t *cur, uint8_t cls, uint64_t *next) const {
+        const uint64_t *bm = &symMask[(size_t)cls * words];
+        fill(next, next + words, 0);
+        bool any = false;
+        for (uint32_t w = 0; w < words; w++) {
+            uint64_t bits = cur[w] & bm[w];
+            while (bits) {
+                uint32_t p = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                const uint64_t *f = &follow[(size_t)p * words];
+                for (uint32_t v = 0; v < words; v++) next[v] |= f[v];
+                any = true;
+            }
+        }
+        return any;
+    }
+
+    bool simulate(string_view input) const {
+        if (words == 1) {
+            uint64_t cur = startMask[0];
+            for (size_t i = 0; i < input.size(); i++) {
+                uint64_t bits = cur & symMask[classes.classOf[
+                                    (unsigned char)input[i]]];
+                uint64_t next = 0;
+                while (bits) {
+                    next |= follow[__builtin_ctzll(bits)];
+                    bits &= bits - 1;
+                }
+                if (!next) {
+                    statAdd(StatBytesScanned, i + 1);
+                    return false;
+                }
+                cur = next;
+            }
+            statAdd(StatBytesScanned, input.size());
+            return test(&cur, finalPos);
+        }
+
+        vector<uint64_t> cur(startMask), next(words);
+        for (size_t i = 0; i < input.size(); i++) {
+            if (!step(cur.data(), classes.classOf[(unsigned char)input[i]],
+                      next.data())) {
+                statAdd(StatBytesScanned, i + 1);
+                return false;
+            }
+            cur.swap(next);
+        }
+        statAdd(StatBytesScanned, input.size());
+        return test(cur.data(), finalPos);
+    }
+};
+
+BitNFA compileBitNFA(const NFA &nfa) {
+    BitNFA bn;
+    bn.classes = computeByteClasses(nfa);
+
+    /* One position per (from, to) pair, labelled with the byte classes
+       that take that edge */
+    struct Edge { int from, to; vector<bool> labels; };
+    vector<Edge> edges;
+    map<int, vector<uint32_t>> edgesFrom;   /* NFA state -> positions */
+    for (auto &[from, mp] : nfa.transitions) {
+        map<int, uint32_t> byTarget;
+        for (auto &[c, tos] : mp)
+            for (int t : tos) {
+                auto it = byTarget.find(t);
+                if (it == byTarget.end()) {
+                    it = byTarget.emplace(t, edges.size()).first;
+                    edges.push_back({from, t,
+                                     vector<bool>(bn.classes.numClasses)});
+                    edgesFrom[from].push_back(it->second);
+                }
+                edges[it->second].labels[bn.classes.classOf[(unsigned char)c]]
+                    = true;
+            }
+    }
+
+    bn.numPositions = edges.size() + 1;
+    bn.finalPos = edges.size();
+    bn.words = (bn.numPositions + 63) / 64;
+
+    /* Mask of positions active when the NFA is in closure({s}) */
+    auto closureMask = [&](int s, uint64_t *mask) {
+        set<int> cl = {s};
+        nfa.epsilonClosure(cl);
+        for (int x : cl) {
+            auto it = edgesFrom.find(x);
+            if (it != edgesFrom.end())
+                for (uint32_t p : it->second)
+                    mask[p >> 6] |= uint64_t(1) << (p & 63);
+            if (nfa.finalStates.count(x))
+                mask[bn.finalPos >> 6] |= uint64_t(1) << (bn.finalPos & 63);
+        }
+    };
+
+    bn.startMask.assign(bn.words, 0);
+    closureMask(nfa.startState, bn.startMask.data());
+
+    bn.symMask.assign((size_t)bn.classes.numClasses * bn.words, 0);
+    bn.follow.assign((size_t)bn.numPositions * bn.words, 0);
+    for (uint32_t p = 0; p < edges.size(); p++) {
+        for (uint32_t cls = 0; cls < bn.classes.numClasses; cls++)
+            if (edges[p].labels[cls])
+                bn.symMask[(size_t)cls * bn.words + (p >> 6)]
+                    |= uint64_t(1) << (p & 63);
+        closureMask(edges[p].to, &bn.follow[(size_t)p * bn.words]);
+    }
+    return bn;
+}
+
+/* ====================== Approximate Matching ====================== */
+/* All matchers below answer the same question: is there an end position
+   i >= |pattern| in text with dp[i][m] <= maxErrors, where dp is the
+   edit-distance table with dp[0][j] = j and dp[i][0] = 0 (the pattern may
+   start anywhere in the text). */
+
+/* Bytes read and edit-distance cells covered by one approximate scan */
+static void statApprox(size_t bytes, size_t m) {
+    statAdd(StatBytesScanned, bytes);
+    statAdd(StatDPCells, (uint64_t)bytes * m);
+}
+
+/* Reference O(n*m) dynamic program */
+bool approximateMatchDP(string_view text,
+                        string_view pattern,
+                        int maxErrors) {
+    int n = text.size(), m = pattern.size();
+    vector<vector<int>> dp(n+1, vector<int>(m+1));
+    statApprox(n, m);
+
+    for (int j = 0; j <= m; j++) dp[0][j] = j;
+
+    for (int i = 1; i <= n; i++) {
+        dp[i][0] = 0;
+        for (int j = 1; j <= m; j++) {
+            if (text[i-1] == pattern[j-1])
+                dp[i][j] = dp[i-1][j-1];
+            else
+                dp[i][j] = 1 + min({ dp[i-1][j],
+                                     dp[i][j-1],
+                                     dp[i-1][j-1] });
+        }
+    }
+
+    for (int i = m; i <= n; i++)
+        if (dp[i][m] <= maxErrors) return true;
+
+    return false;
+}
+
+/* Cases every matcher answers the same way without scanning */
+static bool approximateTrivial(size_t n, size_t m, int maxErrors,
+                               bool &result) {
+    if (maxErrors < 0)            { result = false;  return true; }
+    if ((size_t)maxErrors >= m)   { result = n >= m; return true; }
+    return false;
+}
+
+/* Ukkonen's cut-off: the dp column is only computed down to the row
+   after the last one holding <= maxErrors, since every cell below it is
+   already over the limit. Expected O(n * k) on random text instead of
+   O(n * m). Calls onHit(size_t end, int errors) for each end i >= m
+   with dp[i][m] <= maxErrors, stopping after the first with
+   firstHitOnly; returns the number of hits. */
+template <class F>
+size_t approximateUkkonen(string_view text, string_view pattern,
+                          int maxErrors, F &&onHit,
+                          bool firstHitOnly = false) {
+    size_t n = text.size(), m = pattern.size();
+    if (maxErrors < 0) return 0;
+
+    size_t k = maxErrors, hits = 0, cells = 0, i = 0;
+    vector<uint32_t> col(m + 1);
+    for (size_t j = 0; j <= m; j++) col[j] = j;
+    size_t top = min(k + 1, m);  /* rows 1..top are computed next */
+    for (; i < n; i++) {
+        unsigned char c = text[i];
+        uint32_t diag = 0, up = 0;   /* dp[i-1][j-1], dp[i][j-1] */
+        for (size_t j = 1; j <= top; j++) {
+            uint32_t left = col[j];
+            up = (unsigned char)pattern[j-1] == c
+               ? diag : 1 + min({diag, left, up});
+            diag = left;
+            col[j] = up;
+        }
+        cells += top;
+
+        size_t last = top;           /* last active row */
+        while (col[last] > k) last--;
+        if (last == m) {
+            if (i + 1 >= m) {
+                hits++;
+                onHit(i + 1, (int)col[m]);
+                if (firstHitOnly) {
+                    i++;
+                    break;
+                }
+            }
+            top = m;
+        } else {
+            top = last + 1;
+        }
+    }
+    statAdd(StatBytesScanned, i);
+    statAdd(StatDPCells, cells);
+    return hits;
+}
+
+bool approximateMatchUkkonen(string_view text,
+                             string_view pattern,
+                             int maxErrors) {
+    bool result;
+    if (approximateTrivial(text.size(), pattern.size(), maxErrors, result))
+        return result;
+    return approximateUkkonen(text, pattern, maxErrors,
+                              [](size_t, int) {}, true) > 0;
+}
+
+/* Myers' bit-vector algorithm, one column of dp per text byte, packed
+   into ceil(m/64) words of vertical deltas (Pv = +1, Mv = -1). */
+struct MyersPattern {
+    uint32_t m = 0;
+    uint32_t words = 0;
+    uint64_t lastBit = 0;        /* row m's bit within the last word */
+    vector<uint64_t> peq;        /* 256 x words match masks */
+
+    explicit MyersPattern(string_view pattern)
+        : m(pattern.size()), words((pattern.size() + 63) / 64) {
+        peq.assign((size_t)256 * max<uint32_t>(words, 1), 0);
+        for (uint32_t j = 0; j < m; j++)
+            peq[(size_t)(unsigned char)pattern[j] * words + j / 64]
+                |= uint64_t(1) << (j % 64);
+        lastBit = m ? uint64_t(1) << ((m - 1) % 64) : 0;
+    }
+};
+
+struct MyersState {
+    vector<uint64_t> pv, mv;
+    int score = 0;               /* dp[i][m] for the last byte consumed */
+
+    explicit MyersState(const MyersPattern &p)
+        : pv(p.words, ~uint64_t(0)), mv(p.words, 0), score(p.m) {}
+
+    /* Consume one text byte; returns the new dp[i][m] */
+    int step(const MyersPattern &p, unsigned char c) {
+        const uint64_t *eqs = &p.peq[(size_t)c * p.words];
+        int hin = 0;   /* dp[i][0] - dp[i-1][0] is always 0 */
+        for (uint32_t w = 0; w < p.words; w++) {
+            uint64_t Pv = pv[w], Mv = mv[w], Eq = eqs[w];
+            uint64_t high = w + 1 == p.words ? p.lastBit
+                                             : uint64_t(1) << 63;
+            uint64_t Xv = Eq | Mv;
+            if (hin < 0) Eq |= 1;
+            uint64_t Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+            uint64_t Ph = Mv | ~(Xh | Pv);
+            uint64_t Mh = Pv & Xh;
+            int hout = (Ph & high) ? 1 : (Mh & high) ? -1 : 0;
+            Ph <<= 1;
+            Mh <<= 1;
+            if (hin < 0) Mh |= 1;
+            else if (hin > 0) Ph |= 1;
+            pv[w] = Mh | ~(Xv | Ph);
+            mv[w] = Ph & Xv;
+            hin = hout;
+        }
+        return score += hin;
+    }
+};
+
+/* The Myers scan over n symbols, where symbolAt(i) gives the row of
+   p.peq for the i-th text symbol (called once per i, in order), so bytes
+   and packed bases share it */
+template <class Symbol>
+static bool myersScan(const MyersPattern &p, size_t n, int maxErrors,
+                      Symbol &&symbolAt) {
+    size_t m = p.m;
+    if (p.words == 1) {
+        /* Single-word fast path: the loop above with hin == 0 */
+        uint64_t Pv = ~uint64_t(0), Mv = 0;
+        int score = m;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t Eq = p.peq[symbolAt(i)];
+            uint64_t Xv = Eq | Mv;
+            uint64_t Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+            uint64_t Ph = Mv | ~(Xh | Pv);
+            uint64_t Mh = Pv & Xh;
+            if (Ph & p.lastBit) score++;
+            else if (Mh & p.lastBit) score--;
+            Ph <<= 1;
+            Mh <<= 1;
+            Pv = Mh | ~(Xv | Ph);
+            Mv = Ph & Xv;
+            if (score <= maxErrors && i + 1 >= m) {
+                statApprox(i + 1, m);
+                return true;
+            }
+        }
+        statApprox(n, m);
+        return false;
+    }
+
+    MyersState st(p);
+    for (size_t i = 0; i < n; i++)
+        if (st.step(p, symbolAt(i)) <= maxErrors && i + 1 >= m) {
+            statApprox(i + 1, m);
+            return true;
+        }
+    statApprox(n, m);
+    return false;
+}
+
+/* O(n * ceil(m/64)) time, O(m) memory */
+bool approximateMatchMyers(string_view text,
+                           string_view pattern,
+                           int maxErrors) {
+    bool result;
+    if (approximateTrivial(text.size(), pattern.size(), maxErrors, result))
+        return result;
+    return myersScan(MyersPattern(pattern), text.size(), maxErrors,
+                     [&](size_t i) { return (unsigned char)text[i]; });
+}
+
+/* Wu-Manber k-error shift-and: R[j] bit q set iff pattern[0..q] matches a
+   suffix of the text read so far with at most j errors. O(n * k) time;
+   needs m <= 64 and falls back to Myers otherwise. */
+bool approximateMatchWuManber(string_view text,
+                              string_view pattern,
+                              int maxErrors) {
+    size_t n = text.size(), m = pattern.size();
+    bool result;
+    if (approximateTrivial(n, m, maxErrors, result)) return result;
+    if (m > 64) return approximateMatchMyers(text, pattern, maxErrors);
+
+    uint64_t B[256] = {0};
+    for (size_t q = 0; q < m; q++)
+        B[(unsigned char)pattern[q]] |= uint64_t(1) << q;
+    uint64_t accept = uint64_t(1) << (m - 1);
+
+    int k = maxErrors;
+    vector<uint64_t> R(k + 1);
+    for (int j = 0; j <= k; j++)
+        R[j] = (uint64_t(1) << j) - 1;   /* j leading deletions */
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t mask = B[(unsigned char)text[i]];
+        uint64_t prevOld = R[0];
+        R[0] = ((R[0] << 1) | 1) & mask;
+        for (int j = 1; j <= k; j++) {
+            uint64_t old = R[j];
+            R[j] = (((old << 1) | 1) & mask)   /* match */
+                 | prevOld                    /* insertion */
+                 | (prevOld << 1) | 1         /* substitution */
+                 | (R[j-1] << 1);             /* deletion */
+            prevOld = old;
+        }
+        if ((R[k] & accept) && i + 1 >= m) {
+            statApprox(i + 1, m);
+            return true;
+        }
+    }
+    statApprox(n, m);
+    return false;
+}
+
+/* Streaming matcher: text arrives in chunks and only the current Myers
+   column (O(m) bits) is kept, so inputs larger than memory can be
+   scanned. Every end position i >= m (counted over all bytes fed so
+   far, 1-based) with dp[i][m] <= maxErrors is reported together with its
+   edit count. With skipLineBreaks, '\n' and '\r' are dropped before
+   matching and not counted, which suits line-wrapped sequence files. */
+class ApproxStream {
+public:
+    ApproxStream(string_view pattern, int maxErrors,
+                 bool skipLineBreaks = false)
+        : pat(pattern), state(pat), maxErrors(maxErrors),
+          skipLineBreaks(skipLineBreaks) {}
+
+    /* onHit(size_t end, int errors) */
+    template <class F>
+    void feed(string_view chunk, F &&onHit) {
+        if (maxErrors < 0) return;
+        size_t before = pos;
+        for (unsigned char c : chunk) {
+            if (skipLineBreaks && (c == '\n' || c == '\r')) continue;
+            int score = state.step(pat, c);
+            if (++pos >= pat.m && score <= maxErrors) onHit(pos, score);
+        }
+        statAdd(StatBytesScanned, chunk.size());
+        statAdd(StatDPCells, (uint64_t)(pos - before) * pat.m);
+    }
+
+    size_t consumed() const { return pos; }
+
+    void reset() {
+        state = MyersState(pat);
+        pos = 0;
+    }
+
+private:
+    MyersPattern pat;
+    MyersState state;
+    int maxErrors;
+    bool skipLineBreaks;
+    size_t pos = 0;
+};
+
+/* Runs an ApproxStream over a whole stream in fixed-size chunks;
+   returns the number of hits */
+template <class F>
+size_t approximateScan(istream &in, string_view pattern, int maxErrors,
+                       F &&onHit, bool skipLineBreaks = false,
+                       size_t chunkSize = 1 << 16) {
+    ApproxStream stream(pattern, maxErrors, skipLineBreaks);
+    vector<char> buf(max<size_t>(chunkSize, 1));
+    size_t hits = 0;
+    while (in) {
+        in.read(buf.data(), buf.size());
+        stream.feed(string_view(buf.data(), in.gcount()),
+                    [&](size_t end, int errors) {
+                        hits++;
+                        onHit(end, errors);
+                    });
+    }
+    return hits;
+}
+
+/* Myers while the pattern fits one word; beyond that the cut-off wins
+   until k approaches twice the word count (measured on random DNA) */
+static bool approximateMatchFull(string_view text,
+                                 string_view pattern,
+                                 int maxErrors) {
+    size_t words = (pattern.size() + 63) / 64;
+    if (words > 1 && maxErrors >= 0 && (size_t)maxErrors < 2 * words)
+        return approximateMatchUkkonen(text, pattern, maxErrors);
+    return approximateMatchMyers(text, pattern, maxErrors);
+}
+
+/* Does some end e >= minEnd of window have dp[e][m] <= maxErrors? Plain
+   column dp; the windows are only a few pattern lengths long. */
+static bool verifyWindowScalar(string_view window, string_view pattern,
+                               int maxErrors, size_t minEnd) {
+    size_t m = pattern.size();
+    vector<uint32_t> col(m + 1);
+    for (size_t j = 0; j <= m; j++) col[j] = j;
+    for (size_t i = 0; i < window.size(); i++) {
+        uint32_t diag = col[0];
+        col[0] = 0;
+        for (size_t j = 1; j <= m; j++) {
+            uint32_t up = col[j];
+            col[j] = window[i] == pattern[j-1]
+                   ? diag : 1 + min({diag, up, col[j-1]});
+            diag = up;
+        }
+        if (i + 1 >= minEnd && col[m] <= (uint32_t)maxErrors) return true;
+    }
+    return false;
+}
+
+#ifdef SEARCHSYSTEM_AVX2
+/* The same dp swept by anti-diagonals d = i + j, whose cells depend only
+   on the two previous diagonals, so 16 rows are computed at once in
+   16-bit lanes. Cells are clamped to maxErrors + 1, which keeps them in
+   range without changing which are <= maxErrors. The window is reversed
+   so that text and pattern bytes both advance with j. */
+__attribute__((target("avx2")))
+static bool verifyWindowAVX2(string_view window, string_view pattern,
+                             int maxErrors, size_t minEnd) {
+    const size_t PAD = 16;
+    size_t W = window.size(), m = pattern.size(), row = m + 1 + PAD;
+    uint16_t cap = maxErrors + 1;
+    vector<uint16_t> buf(3 * row, 0);
+    uint16_t *d2 = buf.data(), *d1 = d2 + row, *d0 = d1 + row;
+    string rt(window.rbegin(), window.rend()), pp(pattern);
+    rt.append(PAD, '\0');
+    pp.append(PAD, '\0');
+
+    /* Diagonals 0 and 1: dp[0][0], then dp[1][0] and dp[0][1] */
+    d2[0] = 0;
+    d1[0] = 0;
+    d1[1] = min<uint16_t>(1, cap);
+    __m256i one = _mm256_set1_epi16(1), capv = _mm256_set1_epi16(cap);
+    for (size_t d = 2; d <= W + m; d++) {
+        size_t lo = d > W ? max<size_t>(1, d - W) : 1, hi = min(m, d - 1);
+        for (size_t j = lo; j <= hi; j += 16) {
+            __m256i diag = _mm256_loadu_si256((const __m256i *)(d2 + j - 1));
+            __m256i up = _mm256_loadu_si256((const __m256i *)(d1 + j));
+            __m256i left = _mm256_loadu_si256((const __m256i *)(d1 + j - 1));
+            __m128i tb = _mm_loadu_si128((const __m128i *)&rt[W - d + j]);
+            __m128i pb = _mm_loadu_si128((const __m128i *)&pp[j - 1]);
+            /* -1 where the bytes match */
+            __m256i eq = _mm256_cvtepi8_epi16(_mm_cmpeq_epi8(tb, pb));
+            __m256i v = _mm256_add_epi16(diag, _mm256_add_epi16(one, eq));
+            v = _mm256_min_epu16(v, _mm256_add_epi16(
+                                        _mm256_min_epu16(up, left), one));
+            _mm256_storeu_si256((__m256i *)(d0 + j),
+                                _mm256_min_epu16(v, capv));
+        }
+        /* Boundary cells, after the stores that may run past hi */
+        if (d <= W) d0[0] = 0;
+        if (d <= m) d0[d] = min<size_t>(d, cap);
+        if (hi == m && d - m >= minEnd && d0[m] < cap) return true;
+        uint16_t *t = d2;
+        d2 = d1;
+        d1 = d0;
+        d0 = t;
+    }
+    return false;
+}
+#endif
+
+typedef bool (*VerifyWindowFn)(string_view, string_view, int, size_t);
+
+static VerifyWindowFn chooseVerifyWindow() {
+#ifdef SEARCHSYSTEM_AVX2
+    if (__builtin_cpu_supports("avx2")) return verifyWindowAVX2;
+#endif
+    return verifyWindowScalar;
+}
+
+/* Pigeonhole filter: k edits touch at most k of k+1 disjoint pattern
+   pieces, so every match contains one piece exactly. One Aho-Corasick
+   pass finds the piece hits; each bounds a window of m + 2k bytes around
+   where the match can lie, and only the merged windows are verified.
+   When the windows cover a large part of the text anyway the full scan
+   is used instead. verify picks the window verifier; by default it is
+   the fastest one the CPU supports. */
+bool approximateMatchFiltered(string_view text,
+                              string_view pattern,
+                              int maxErrors,
+                              VerifyWindowFn verify = nullptr) {
+    size_t n = text.size(), m = pattern.size();
+    bool result;
+    if (approximateTrivial(n, m, maxErrors, result)) return result;
+    size_t k = maxErrors, pieces = k + 1;
+
+    vector<string> seeds;
+    vector<size_t> offsets;
+    for (size_t p = 0; p < pieces; p++) {
+        size_t a = p * m / pieces, b = (p + 1) * m / pieces;
+        seeds.emplace_back(pattern.substr(a, b - a));
+        offsets.push_back(a);
+    }
+
+    /* Piece at text offset s: the match lies in [s - off - k,
+       s - off + m + k) */
+    vector<pair<size_t, size_t>> windows;
+    buildAhoCorasick(seeds).search(text, [&](uint32_t id, size_t s) {
+        size_t off = offsets[id];
+        windows.emplace_back(s >= off + k ? s - off - k : 0,
+                             min(n, s - off + m + k));
+    });
+    sort(windows.begin(), windows.end());
+
+    vector<pair<size_t, size_t>> merged;
+    size_t covered = 0;
+    for (auto &w : windows) {
+        if (!merged.empty() && w.first <= merged.back().second) {
+            merged.back().second = max(merged.back().second, w.second);
+            continue;
+        }
+        if (!merged.empty())
+            covered += merged.back().second - merged.back().first;
+        merged.push_back(w);
+    }
+    if (!merged.empty()) covered += merged.back().second - merged.back().first;
+    if (covered > n / 4) return approximateMatchFull(text, pattern, maxErrors);
+
+    static const VerifyWindowFn best = chooseVerifyWindow();
+    if (!verify) verify = best;
+    /* 16-bit lanes hold cells up to maxErrors + 1 */
+    if (maxErrors >= 0x7FFF) verify = verifyWindowScalar;
+    for (auto &w : merged) {
+        string_view window = text.substr(w.first, w.second - w.first);
+        statApprox(window.size(), m);
+        if (verify(window, pattern, maxErrors,
+                 w.first >= m ? 1 : m - w.first))
+            return true;
+    }
+    return false;
+}
+
+/* Shorter pieces hit too often for the filter to pay off */
+static const size_t SEED_MIN_LENGTH = 12;
+
+/* Seeded filter when the pieces are long enough, full scan otherwise */
+bool approximateMatch(string_view text,
+                      string_view pattern,
+                      int maxErrors) {
+    if (maxErrors >= 0 &&
+        pattern.size() / ((size_t)maxErrors + 1) >= SEED_MIN_LENGTH)
+        return approximateMatchFiltered(text, pattern, maxErrors);
+    return approximateMatchFull(text, pattern, maxErrors);
+}
+
+/* Approximate regex search (agrep/TRE style) on the bit-parallel NFA:
+   level j holds the positions reachable with at most j edits, and per
+   text byte each level takes matches from itself plus insertions,
+   substitutions and deletions from the level below, so a scan is one
+   linear pass with k + 1 masks. "Any edge" moves ignore labels; when
+   the automaton fits one word they are eight 256-entry table lookups.
+   As with approximateMatch, the match may start anywhere and ends before
+   the regex's shortest match length do not count, so a literal gives
+   exactly approximateMatch's answers. skipLineBreaks works as in
+   ApproxStream. */
+class ApproxRegex {
+public:
+    ApproxRegex(const NFA &nfa, int maxErrors, bool skipLineBreaks = false)
+        : bits(compileBitNFA(nfa)), maxErrors(maxErrors),
+          skipLineBreaks(skipLineBreaks) {
+        uint32_t w = bits.words;
+        if (w == 1) {
+            chunkFollow.assign((size_t)(bits.numPositions + 7) / 8 * 256, 0);
+            for (uint32_t p = 0; p < bits.numPositions; p++)
+                for (uint32_t b = 0; b < 256; b++)
+                    if (b >> (p & 7) & 1)
+                        chunkFollow[(p >> 3) * 256 + b] |= bits.follow[p];
+        }
+
+        size_t levels = max(maxErrors, 0) + 1;
+        startLevels.assign(levels * w, 0);
+        copy(bits.startMask.begin(), bits.startMask.end(),
+             startLevels.begin());
+        for (size_t j = 1; j < levels; j++) {
+            uint64_t *prev = &startLevels[(j - 1) * w], *cur = prev + w;
+            anyMove(prev, cur);
+            for (uint32_t v = 0; v < w; v++) cur[v] |= prev[v];
+        }
+
+        /* Shortest accepted length: BFS over exact moves */
+        vector<uint64_t> level(bits.startMask), next(w);
+        for (size_t len = 0; len <= bits.numPositions; len++) {
+            if (BitNFA::test(level.data(), bits.finalPos)) {
+                minLength = len;
+                break;
+            }
+            anyMove(level.data(), next.data());
+            level.swap(next);
+        }
+    }
+
+    /* onHit(size_t end, int errors) for every end with a match of at most
+       maxErrors edits (errors is the fewest), stopping after the first
+       with firstHitOnly; returns the number of hits */
+    template <class F>
+    size_t scan(string_view text, F &&onHit,
+                bool firstHitOnly = false) const {
+        if (maxErrors < 0 || minLength == NEVER) return 0;
+        return bits.words == 1 ? scanWord(text, onHit, firstHitOnly)
+                               : scanWide(text, onHit, firstHitOnly);
+    }
+
+    bool match(string_view text) const {
+        return scan(text, [](size_t, int) {}, true) > 0;
+    }
+
+    /* Bytes held by the masks and tables */
+    size_t memoryBytes() const {
+        return (bits.startMask.size() + bits.symMask.size() +
+                bits.follow.size() + chunkFollow.size() +
+                startLevels.size()) * sizeof(uint64_t);
+    }
+
+private:
+    static constexpr size_t NEVER = ~size_t(0);
+
+    BitNFA bits;
+    int maxErrors;
+    bool skipLineBreaks;
+    size_t minLength = NEVER;
+    vector<uint64_t> chunkFollow;    /* words == 1: (numPositions/8) x 256 */
+    vector<uint64_t> startLevels;    /* (maxErrors+1) x words */
+
+    /* Positions after taking any one edge from the positions in m */
+    uint64_t anyMove(uint64_t m) const {
+        uint64_t out = 0;
+        for (const uint64_t *t = chunkFollow.data(); m; m >>= 8, t += 256)
+            out |= t[m & 255];
+        return out;
+    }
+
+    void anyMove(const uint64_t *m, uint64_t *out) const {
+        uint32_t w = bits.words;
+        if (w == 1) {
+            out[0] = anyMove(m[0]);
+            return;
+        }
+        fill(out, out + w, 0);
+        for (uint32_t v = 0; v < w; v++)
+            for (uint64_t b = m[v]; b; b &= b - 1) {
+                const uint64_t *f =
+                    &bits.follow[(size_t)(v * 64 + __builtin_ctzll(b)) * w];
+                for (uint32_t u = 0; u < w; u++) out[u] |= f[u];
+            }
+    }
+
+    bool skipped(unsigned char c) const {
+        return skipLineBreaks && (c == '\n' || c == '\r');
+    }
+
+    template <class F>
+    size_t scanWord(string_view text, F &onHit, bool firstHitOnly) const {
+        uint32_t k = maxErrors;
+        vector<uint64_t> R(startLevels);
+        uint64_t fin = uint64_t(1) << bits.finalPos, start = startLevels[0];
+        const uint8_t *cls = bits.classes.classOf.data();
+        size_t pos = 0, hits = 0, i = 0;
+        for (; i < text.size(); i++) {
+            unsigned char c = text[i];
+            if (skipped(c)) continue;
+            uint64_t sym = bits.symMask[cls[c]];
+            uint64_t below = R[0];               /* level j-1 before c */
+            uint64_t r = anyMove(R[0] & sym) | start;
+            R[0] = r;
+            for (uint32_t j = 1; j <= k; j++) {
+                uint64_t old = R[j];
+                /* match | insert | substitute or delete | fewer edits */
+                r = anyMove(old & sym) | below | anyMove(below | r) | r;
+                below = old;
+                R[j] = r;
+            }
+            pos++;
+            if ((r & fin) && pos >= minLength) {
+                int errors = 0;
+                while (!(R[errors] & fin)) errors++;
+                hits++;
+                onHit(pos, errors);
+                if (firstHitOnly) {
+                    i++;
+                    break;
+                }
+            }
+        }
+        statAdd(StatBytesScanned, i);
+        return hits;
+    }
+
+    template <class F>
+    size_t scanWide(string_view text, F &onHit, bool firstHitOnly) const {
+        uint32_t k = maxErrors, w = bits.words;
+        vector<uint64_t> R(startLevels), below(w), old(w), tmp(w), moved(w);
+        const uint8_t *cls = bits.classes.classOf.data();
+        size_t pos = 0, hits = 0, i = 0;
+        for (; i < text.size(); i++) {
+            unsigned char c = text[i];
+            if (skipped(c)) continue;
+            const uint64_t *sym = &bits.symMask[(size_t)cls[c] * w];
+            for (uint32_t j = 0; j <= k; j++) {
+                uint64_t *r = &R[(size_t)j * w];
+                copy(r, r + w, old.begin());
+                for (uint32_t v = 0; v < w; v++) tmp[v] = old[v] & sym[v];
+                anyMove(tmp.data(), r);
+                if (j == 0) {
+                    for (uint32_t v = 0; v < w; v++) r[v] |= startLevels[v];
+                } else {
+                    const uint64_t *rb = r - w;   /* level j-1, updated */
+                    for (uint32_t v = 0; v < w; v++) tmp[v] = below[v] | rb[v];
+                    anyMove(tmp.data(), moved.data());
+                    for (uint32_t v = 0; v < w; v++)
+                        r[v] |= tmp[v] | moved[v];
+                }
+                below.swap(old);
+            }
+            pos++;
+            if (BitNFA::test(&R[(size_t)k * w], bits.finalPos) &&
+                pos >= minLength) {
+                int errors = 0;
+                while (!BitNFA::test(&R[(size_t)errors * w], bits.finalPos))
+                    errors++;
+                hits++;
+                onHit(pos, errors);
+                if (firstHitOnly) {
+                    i++;
+                    break;
+                }
+            }
+        }
+        statAdd(StatBytesScanned, i);
+        return hits;
+    }
+};
+
+/* Throws invalid_argument on a malformed regex */
+bool approximateRegexMatch(string_view text, const string &regex,
+                           int maxErrors) {
+    return ApproxRegex(regexToNFA(regex), maxErrors).match(text);
+}
+
+/* ====================== Packed DNA ====================== */
+/* ACGT at two bits per base, 32 bases per word with the first base in
+   the lowest bits. The code is (c >> 1) & 3, i.e. A 0, C 1, T 2, G 3,
+   which also holds for lower case, so encoding is a shift and a mask.
+   Bases read back as upper case. Word and byte order are little-endian,
+   like the compiled DFA files. */
+static const char DNA_BASES[4] = {'A', 'C', 'T', 'G'};
+
+inline uint8_t dnaCode(unsigned char c) { return (c >> 1) & 3; }
+
+inline bool isDNABase(unsigned char c) {
+    c |= 0x20;
+    return c == 'a' || c == 'c' || c == 'g' || c == 't';
+}
+
+class PackedDNA {
+public:
+    PackedDNA() = default;
+    explicit PackedDNA(string_view bases, bool skipLineBreaks = false) {
+        append(bases, skipLineBreaks);
+    }
+
+    /* Streaming encoder: chunks may split anywhere. Throws
+       invalid_argument on a byte that is not a base; with skipLineBreaks
+       '\n' and '\r' are dropped instead. */
+    void append(string_view chunk, bool skipLineBreaks = false) {
+        /* Room for the whole chunk, growing geometrically so many small
+           appends stay linear */
+        size_t want = (length + chunk.size()) / 32 + 1;
+        if (want > words.capacity())
+            words.reserve(max(want, 2 * words.capacity()));
+        size_t i = 0, n = chunk.size();
+        while (i + 8 <= n) {
+            uint64_t x;
+            memcpy(&x, chunk.data() + i, 8);
+            if (allBases(x)) {
+                put(pack8(x), 8);
+                i += 8;
+                continue;
+            }
+            for (size_t e = i + 8; i < e; i++)
+                putByte(chunk[i], skipLineBreaks);
+        }
+        for (; i < n; i++) putByte(chunk[i], skipLineBreaks);
+    }
+
+    size_t size() const { return length; }
+    const uint64_t *data() const { return words.data(); }
+    size_t memoryBytes() const { return words.capacity() * sizeof(uint64_t); }
+
+    uint8_t code(size_t i) const {
+        return (words[i >> 5] >> ((i & 31) * 2)) & 3;
+    }
+
+    char base(size_t i) const { return DNA_BASES[code(i)]; }
+
+    string unpack(size_t pos = 0, size_t len = string::npos) const {
+        string out;
+        len = min(len, length - min(pos, length));
+        out.reserve(len);
+        for (size_t i = pos; i < pos + len; i++) out += base(i);
+        return out;
+    }
+
+private:
+    vector<uint64_t> words;
+    size_t length = 0;
+
+    /* 0x80 in each byte of t that is zero, exactly (no borrow spill) */
+    static uint64_t zeroBytes(uint64_t t) {
+        const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+        return ~(((t & low7) + low7) | t | low7);
+    }
+
+    static bool allBases(uint64_t x) {
+        const uint64_t ones = 0x0101010101010101ULL;
+        uint64_t y = x | ones * 0x20;
+        uint64_t hit = zeroBytes(y ^ ones * 'a') | zeroBytes(y ^ ones * 'c') |
+                       zeroBytes(y ^ ones * 'g') | zeroBytes(y ^ ones * 't');
+        return hit == ones * 0x80;
+    }
+
+    /* Eight bytes of bases to their 16 packed bits */
+    static uint64_t pack8(uint64_t x) {
+        uint64_t t = (x >> 1) & 0x0303030303030303ULL;
+        t = (t | t >> 6) & 0x000F000F000F000FULL;
+        t = (t | t >> 12) & 0x000000FF000000FFULL;
+        return (t | t >> 24) & 0xFFFF;
+    }
+
+    void put(uint64_t bits, size_t count) {
+        size_t off = (length & 31) * 2;
+        if (off == 0) words.push_back(0);
+        words.back() |= bits << off;
+        if (off + 2 * count > 64) words.push_back(bits >> (64 - off));
+        length += count;
+    }
+
+    void putByte(unsigned char c, bool skipLineBreaks) {
+        if (skipLineBreaks && (c == '\n' || c == '\r')) return;
+        if (!isDNABase(c))
+            throw invalid_argument("DNA error at base " + to_string(length) +
+                                   ": not one of ACGT");
+        put(dnaCode(c), 1);
+    }
+};
+
+/* A FlatDFA read over the four bases only. One row of four per state;
+   while the DFA is small a second table steps a whole packed byte (four
+   bases) per lookup, cutting the dependent loads to a quarter. */
+struct PackedDFA {
+    static const uint32_t MAX_QUAD_STATES = 4096;   /* 4 MB quad table */
+
+    uint32_t numStates = 0;
+    uint32_t startState = 0;
+    uint32_t deadState = 0;
+    vector<uint32_t> step1;          /* (numStates+1) x 4 */
+    vector<uint32_t> step4;          /* (numStates+1) x 256, or empty */
+    uint32_t numFinal = 0;           /* as in FlatDFA */
+
+    explicit PackedDFA(const FlatDFA &dfa)
+        : numStates(dfa.numStates), startState(dfa.startState),
+          deadState(dfa.deadState), numFinal(dfa.numFinal) {
+        size_t rows = (size_t)numStates + 1;
+        step1.resize(rows * 4);
+        for (size_t s = 0; s < rows; s++)
+            for (uint32_t c = 0; c < 4; c++)
+                step1[s * 4 + c] = dfa.step(s, DNA_BASES[c]);
+        if (numStates > MAX_QUAD_STATES) return;
+
+        step4.resize(rows * 256);
+        for (size_t s = 0; s < rows; s++)
+            for (uint32_t b = 0; b < 256; b++) {
+                uint32_t t = s;
+                for (uint32_t q = 0; q < 8; q += 2)
+                    t = step1[(size_t)t * 4 + ((b >> q) & 3)];
+                step4[s * 256 + b] = t;
+            }
+    }
+
+    bool isFinal(uint32_t s) const { return s < numFinal; }
+
+    /* Whole-sequence match, as FlatDFA::simulate on the unpacked bases */
+    bool simulate(const PackedDNA &dna) const {
+        size_t n = dna.size(), i = 0;
+        uint32_t s = startState;
+        if (!step4.empty()) {
+            const uint8_t *bytes =
+                reinterpret_cast<const uint8_t *>(dna.data());
+            const uint32_t *t = step4.data();
+            for (; i + 4 <= n; i += 4) {
+                s = t[(size_t)s * 256 + bytes[i >> 2]];
+                if (s == deadState) {
+                    statScan(i + 4, true);
+                    return false;
+                }
+            }
+        }
+        for (; i < n; i++) {
+            s = step1[(size_t)s * 4 + dna.code(i)];
+            if (s == deadState) {
+                statScan(i + 1, true);
+                return false;
+            }
+        }
+        statScan(n, false);
+        return isFinal(s);
+    }
+};
+
+/* Myers over packed bases, comparing them case-insensitively. Pattern
+   bytes that are not bases get row 4, which no text base selects, so
+   they always count as a mismatch as they would against unpacked DNA. */
+bool approximateMatchMyers(const PackedDNA &text,
+                           string_view pattern,
+                           int maxErrors) {
+    bool result;
+    if (approximateTrivial(text.size(), pattern.size(), maxErrors, result))
+        return result;
+    string codes(pattern);
+    for (char &c : codes) c = isDNABase(c) ? dnaCode(c) : 4;
+    /* myersScan reads the symbols in order, so shift through each word */
+    const uint64_t *w = text.data();
+    uint64_t cur = 0;
+    return myersScan(MyersPattern(codes), text.size(), maxErrors,
+                     [w, &cur](size_t i) {
+                         if ((i & 31) == 0) cur = w[i >> 5];
+                         unsigned c = cur & 3;
+                         cur >>= 2;
+                         return c;
+                     });
+}
+
+/* ====================== PDA ====================== */
+/* Deterministic real-time PDA: every input byte takes exactly one move,
+   chosen by (state, byte, top of stack), which may push, pop or replace
+   the top. A string is accepted if every byte had a move and the PDA
+   ends in a final state with an empty stack. Moves are kept in a dense
+   table, built on the first simulate after moves were added, so
+   adding N moves costs one build rather than N; finish adding moves
+   before sharing a PDA between threads. The stack is one preallocated
+   byte array, and automata that only ever push a single symbol run on
+   a plain counter instead. */
+struct PDA {
+    enum Op : uint8_t { Keep, Push, Pop, Replace };
+    /* `top` sentinels, outside the byte range so every byte, '\0' and
+       0xFF included, can be a stack symbol */
+    static constexpr int ANY = 256;    /* any top, or empty */
+    static constexpr int EMPTY = 257;  /* the stack is empty */
+
+    int startState = 0;
+    set<int> finalStates;
+
+    /* top is a stack symbol (a char, read as unsigned), EMPTY or ANY,
+       and anything else throws invalid_argument; symbol is what
+       Push/Replace put on the stack. Adding a move for an existing key
+       replaces it; exact moves win over ANY. A PDA too large for the
+       table throws invalid_argument from the next simulate. */
+    void addTransition(int from, char input, int top, int to, Op op,
+                       char symbol = 0) {
+        if (top != ANY && top != EMPTY) {
+            if (top < -128 || top > 255)
+                throw invalid_argument("PDA stack symbol out of range");
+            top = (unsigned char)top;
+        }
+        rules.push_back({from, (unsigned char)input, top, to, op,
+                         (unsigned char)symbol});
+        dirty = true;
+    }
+
+    bool simulate(string_view input) const {
+        if (dirty) rebuild();
+        if (moves.empty()) return input.empty() && isFinal(startState);
+        return singleSymbol ? runCounter(input) : runStack(input);
+    }
+
+    /* a^n b^n, n >= 0 */
+    static PDA anbn() {
+        PDA p;
+        p.addTransition(0, 'a', ANY, 0, Push, 'A');
+        p.addTransition(0, 'b', 'A', 1, Pop);
+        p.addTransition(1, 'b', 'A', 1, Pop);
+        p.finalStates = {0, 1};
+        p.rebuild();
+        return p;
+    }
+
+    /* Balanced brackets; pairs lists open/close characters, e.g. "()[]".
+       With ignoreOthers every other byte is skipped, otherwise rejected. */
+    static PDA balanced(const string &pairs, bool ignoreOthers = true) {
+        PDA p;
+        if (ignoreOthers) {
+            set<char> special(pairs.begin(), pairs.end());
+            for (int b = 0; b < 256; b++)
+                if (!special.count((char)b))
+                    p.rules.push_back({0, (unsigned char)b, ANY, 0, Keep, 0});
+        }
+        for (size_t i = 0; i + 1 < pairs.size(); i += 2) {
+            p.rules.push_back({0, (unsigned char)pairs[i], ANY, 0, Push,
+                               (unsigned char)pairs[i]});
+            p.rules.push_back({0, (unsigned char)pairs[i+1],
+                               (unsigned char)pairs[i], 0, Pop, 0});
+        }
+        p.rebuild();
+        p.finalStates = {0};
+        return p;
+    }
+
+private:
+    struct Rule {
+        int from;
+        unsigned char input;
+        int top;
+        int to;
+        Op op;
+        unsigned char symbol;
+    };
+    struct Move {
+        int16_t next;       /* -1: no move */
+        Op op;
+        uint8_t symbol;     /* stack symbol id */
+    };
+
+    vector<Rule> rules;
+    /* Derived from rules by rebuild() */
+    mutable vector<Move> moves;  /* numStates x 256 x numSymbols */
+    mutable uint32_t numStates = 0;
+    mutable uint32_t numSymbols = 1;   /* id 0 is the empty-stack marker */
+    mutable bool singleSymbol = false;
+    mutable bool dirty = false;        /* rules changed since rebuild() */
+
+    bool isFinal(int s) const { return finalStates.count(s) > 0; }
+
+    const Move &moveFor(uint32_t s, unsigned char c, uint8_t top) const {
+        return moves[((size_t)s * 256 + c) * numSymbols + top];
+    }
+
+    void rebuild() const {
+        map<unsigned char, uint8_t> symId;
+        int maxState = startState;
+        for (auto &r : rules) {
+            maxState = max({maxState, r.from, r.to});
+            if (r.top != ANY && r.top != EMPTY)
+                symId.emplace(r.top, 0);
+            if (r.op == Push || r.op == Replace)
+                symId.emplace(r.symbol, 0);
+        }
+        if (maxState >= 0x7FFF || symId.size() > 254)
+            throw invalid_argument("PDA too large for a dense table");
+        uint8_t next = 1;
+        for (auto &[c, id] : symId) id = next++;
+
+        numStates = maxState + 1;
+        numSymbols = symId.size() + 1;
+        singleSymbol = symId.size() <= 1;
+        moves.assign((size_t)numStates * 256 * numSymbols,
+                     Move{-1, Keep, 0});
+
+        /* Wildcards first so exact moves overwrite them */
+        for (int pass = 0; pass < 2; pass++)
+            for (auto &r : rules) {
+                if ((r.top == ANY) != (pass == 0)) continue;
+                uint8_t sym = (r.op == Push || r.op == Replace)
+                            ? symId[r.symbol] : 0;
+                Move m{(int16_t)r.to, r.op, sym};
+                size_t base = ((size_t)r.from * 256 + r.input) * numSymbols;
+                if (r.top == ANY)
+                    for (uint32_t t = 0; t < numSymbols; t++)
+                        moves[base + t] = m;
+                else
+                    moves[base + (r.top == EMPTY ? 0 : symId[r.top])] = m;
+            }
+        dirty = false;
+    }
+
+    bool finish(uint32_t s, bool stackEmpty) const {
+        return stackEmpty && isFinal(s);
+    }
+
+    /* Only one stack symbol exists, so the stack is just its depth */
+    bool runCounter(string_view input) const {
+        uint32_t s = startState;
+        size_t depth = 0, peak = 0, i = 0;
+        for (; i < input.size(); i++) {
+            const Move &m = moveFor(s, input[i], depth ? 1 : 0);
+            if (m.next < 0 || (m.op == Pop && !depth)) break;
+            if (m.op == Push) peak = max(peak, ++depth);
+            else if (m.op == Pop) depth--;
+            else if (m.op == Replace && !depth) peak = max(peak, depth = 1);
+            s = m.next;
+        }
+        /* A rejected byte was still read */
+        statAdd(StatBytesScanned, min(i + 1, input.size()));
+        statMax(StatPDAStackPeak, peak);
+        return i == input.size() && finish(s, depth == 0);
+    }
+
+    bool runStack(string_view input) const {
+        /* At most one push per byte, so this never grows */
+        vector<uint8_t> stack(input.size() + 1);
+        size_t depth = 0, peak = 0, i = 0;
+        uint32_t s = startState;
+        for (; i < input.size(); i++) {
+            const Move &m = moveFor(s, input[i],
+                                    depth ? stack[depth - 1] : 0);
+            if (m.next < 0 || (m.op == Pop && !depth)) break;
+            switch (m.op) {
+            case Keep: break;
+            case Push:
+                stack[depth++] = m.symbol;
+                peak = max(peak, depth);
+                break;
+            case Pop: depth--; break;
+            case Replace:
+                if (!depth) peak = max(peak, depth = 1);
+                stack[depth - 1] = m.symbol;
+                break;
+            }
+            s = m.next;
+        }
+        statAdd(StatBytesScanned, min(i + 1, input.size()));
+        statMax(StatPDAStackPeak, peak);
+        return i == input.size() && finish(s, depth == 0);
+    }
+};
+
+/* ====================== CFG Parsing ====================== */
+/* Context-free grammar over bytes. Symbols 0..255 are terminals (the
+   byte itself); nonterminal k is NT + k. */
+struct Grammar {
+    static constexpr int NT = 256;
+
+    vector<string> names;          /* nonterminal names */
+    vector<int> lhs;               /* per production */
+    vector<vector<int>> rhs;
+    int start = NT;
+
+    static int terminal(char c) { return (unsigned char)c; }
+
+    /* Id for a nonterminal name, created on first use; the first one
+       created becomes the start symbol */
+    int nonterminal(const string &name) {
+        for (size_t k = 0; k < names.size(); k++)
+            if (names[k] == name) return NT + k;
+        names.push_back(name);
+        return NT + names.size() - 1;
+    }
+
+    void addRule(int left, vector<int> right) {
+        lhs.push_back(left);
+        rhs.push_back(move(right));
+    }
+
+    size_t numNonterminals() const { return names.size(); }
+};
+
+/* Earley recognizer. Items are (dotted rule, origin) pairs packed into
+   64 bits and stored back to back in one arena vector, set after set.
+   Each set deduplicates through a generation-stamped hash table and
+   tracks already-predicted nonterminals in a packed bitset. Nullable
+   nonterminals are handled Aycock-Horspool style (the dot skips them at
+   prediction time), so completions never need to revisit the set being
+   built. Once a set is finished, its items waiting on each nonterminal
+   are indexed so later completions touch only those, and right-recursive
+   completion chains are collapsed with Leo's memo. Linear on LR(k)
+   grammars, cubic in the worst case. */
+bool earleyRecognize(const Grammar &g, string_view input) {
+    size_t numNT = g.numNonterminals();
+    if (numNT == 0) return false;
+
+    /* Dotted rules: dr = ruleBase[p] + dot; symbolAt[dr] is the symbol
+       after the dot, or -1 when the rule is complete */
+    vector<uint32_t> ruleBase, ruleOf;
+    vector<int> symbolAt;
+    for (size_t p = 0; p < g.rhs.size(); p++) {
+        ruleBase.push_back(symbolAt.size());
+        for (int sym : g.rhs[p]) {
+            symbolAt.push_back(sym);
+            ruleOf.push_back(p);
+        }
+        symbolAt.push_back(-1);
+        ruleOf.push_back(p);
+    }
+
+    vector<vector<uint32_t>> rulesFor(numNT);
+    for (size_t p = 0; p < g.lhs.size(); p++)
+        rulesFor[g.lhs[p] - Grammar::NT].push_back(p);
+
+    vector<char> nullable(numNT, 0);
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (size_t p = 0; p < g.lhs.size(); p++) {
+            int a = g.lhs[p] - Grammar::NT;
+            if (nullable[a]) continue;
+            bool all = true;
+            for (int sym : g.rhs[p])
+                if (sym < Grammar::NT || !nullable[sym - Grammar::NT]) {
+                    all = false;
+                    break;
+                }
+            if (all) nullable[a] = changed = true;
+        }
+    }
+
+    auto pack = [](uint32_t dr, uint32_t origin) {
+        return (uint64_t)dr << 32 | origin;
+    };
+
+    size_t n = input.size();
+    vector<uint64_t> items;                 /* arena: all sets */
+    vector<size_t> setStart = {0};
+    /* waiting[j]: CSR over nonterminals of set j's items, by next symbol */
+    vector<vector<uint32_t>> waitStart(n + 1), waitItems(n + 1);
+
+    vector<uint64_t> slotKey(64);
+    vector<uint32_t> slotGen(64, 0);
+    uint32_t gen = 0;
+    size_t setSize = 0;
+    vector<uint64_t> predicted((numNT + 63) / 64);
+
+    auto add = [&](uint64_t item) {
+        if (setSize * 2 >= slotKey.size()) {
+            /* Grow and re-insert the current set */
+            slotKey.assign(slotKey.size() * 2, 0);
+            slotGen.assign(slotKey.size(), 0);
+            for (size_t k = setStart.back(); k < items.size(); k++) {
+                size_t h = (items[k] * 0x9E3779B97F4A7C15ull) >> 20;
+                while (slotGen[h & (slotKey.size() - 1)] == gen) h++;
+                slotKey[h & (slotKey.size() - 1)] = items[k];
+                slotGen[h & (slotKey.size() - 1)] = gen;
+            }
+        }
+        size_t h = (item * 0x9E3779B97F4A7C15ull) >> 20;
+        for (;; h++) {
+            size_t i = h & (slotKey.size() - 1);
+            if (slotGen[i] != gen) {
+                slotGen[i] = gen;
+                slotKey[i] = item;
+                break;
+            }
+            if (slotKey[i] == item) return;
+        }
+        items.push_back(item);
+        setSize++;
+    };
+
+    auto beginSet = [&]() {
+        if (++gen == 0) {
+            fill(slotGen.begin(), slotGen.end(), 0);
+            gen = 1;
+        }
+        setSize = 0;
+        fill(predicted.begin(), predicted.end(), 0);
+    };
+
+    /* Leo's right-recursion memo: leoTop(j, A) is the topmost completed
+       item reached by following items that are the only ones in their set
+       waiting on a symbol, and wait on it last. Completing A at origin j
+       adds that item directly instead of every item on the chain, which
+       keeps right-recursive grammars linear. startSeen records whether a
+       skipped item would have been an accepting one. */
+    const uint64_t NO_ITEM = ~uint64_t(0);
+    struct Leo { uint64_t top; bool startSeen; };
+    unordered_map<uint64_t, Leo> leoMemo;
+    bool acceptedViaLeo = false;
+    vector<pair<uint64_t, uint64_t>> leoPath;
+    auto leoTop = [&](uint32_t j, int a) -> uint64_t {
+        leoPath.clear();
+        Leo result = {NO_ITEM, false};
+        for (;;) {
+            uint64_t key = (uint64_t)j << 32 | (uint32_t)a;
+            auto found = leoMemo.find(key);
+            if (found != leoMemo.end()) {
+                result = found->second;
+                break;
+            }
+            auto &ws = waitStart[j];
+            leoMemo[key] = {NO_ITEM, false};     /* also breaks unit cycles */
+            if (ws[a + 1] - ws[a] != 1) break;
+            uint64_t parent = items[waitItems[j][ws[a]]];
+            uint32_t dr = (parent >> 32) + 1, origin = (uint32_t)parent;
+            if (symbolAt[dr] >= 0) break;
+            leoPath.push_back({key, pack(dr, origin)});
+            j = origin;
+            a = g.lhs[ruleOf[dr]] - Grammar::NT;
+        }
+        for (size_t k = leoPath.size(); k-- > 0; ) {
+            uint64_t item = leoPath[k].second;
+            if (result.top == NO_ITEM) result.top = item;
+            if ((uint32_t)item == 0 && g.lhs[ruleOf[item >> 32]] == g.start)
+                result.startSeen = true;
+            leoMemo[leoPath[k].first] = result;
+        }
+        if (result.startSeen && setStart.size() == n + 1) acceptedViaLeo = true;
+        return result.top;
+    };
+
+    beginSet();
+    for (uint32_t p : rulesFor[g.start - Grammar::NT]) add(pack(ruleBase[p], 0));
+
+    vector<uint64_t> scanned;
+    for (size_t i = 0; ; i++) {
+        scanned.clear();
+        int next = i < n ? (unsigned char)input[i] : -2;
+
+        for (size_t k = setStart[i]; k < items.size(); k++) {
+            uint32_t dr = items[k] >> 32, origin = (uint32_t)items[k];
+            int sym = symbolAt[dr];
+
+            if (sym < 0) {
+                /* Complete; origin == i is covered by the nullable skip */
+                if (origin == i) continue;
+                int a = g.lhs[ruleOf[dr]] - Grammar::NT;
+                uint64_t top = leoTop(origin, a);
+                if (top != NO_ITEM) {
+                    add(top);
+                    continue;
+                }
+                auto &ws = waitStart[origin];
+                auto &wi = waitItems[origin];
+                for (uint32_t w = ws[a]; w < ws[a + 1]; w++) {
+                    uint64_t parent = items[wi[w]];
+                    add(pack((parent >> 32) + 1, (uint32_t)parent));
+                }
+            } else if (sym < Grammar::NT) {
+                if (sym == next) scanned.push_back(pack(dr + 1, origin));
+            } else {
+                int a = sym - Grammar::NT;
+                if (!(predicted[a >> 6] >> (a & 63) & 1)) {
+                    predicted[a >> 6] |= uint64_t(1) << (a & 63);
+                    for (uint32_t p : rulesFor[a]) add(pack(ruleBase[p], i));
+                }
+                if (nullable[a]) add(pack(dr + 1, origin));
+            }
+        }
+
+        if (i == n) break;
+
+        /* Index this set's items by the nonterminal they wait on */
+        auto &ws = waitStart[i];
+        auto &wi = waitItems[i];
+        ws.assign(numNT + 1, 0);
+        for (size_t k = setStart[i]; k < items.size(); k++) {
+            int sym = symbolAt[items[k] >> 32];
+            if (sym >= Grammar::NT) ws[sym - Grammar::NT + 1]++;
+        }
+        for (size_t a = 0; a < numNT; a++) ws[a + 1] += ws[a];
+        wi.resize(ws[numNT]);
+        {
+            vector<uint32_t> fillPos(ws.begin(), ws.end() - 1);
+            for (size_t k = setStart[i]; k < items.size(); k++) {
+                int sym = symbolAt[items[k] >> 32];
+                if (sym >= Grammar::NT) wi[fillPos[sym - Grammar::NT]++] = k;
+            }
+        }
+
+        if (scanned.empty()) return false;
+        setStart.push_back(items.size());
+        beginSet();
+        for (uint64_t it : scanned) add(it);
+    }
+
+    if (acceptedViaLeo) return true;
+    for (size_t k = setStart[n]; k < items.size(); k++) {
+        uint32_t dr = items[k] >> 32, origin = (uint32_t)items[k];
+        if (origin == 0 && symbolAt[dr] < 0 && g.lhs[ruleOf[dr]] == g.start)
+            return true;
+    }
+    /* Empty input with a nullable start symbol */
+    return n == 0 && nullable[g.start - Grammar::NT];
+}
+
+/* The same language as a grammar in the Chomsky normal form cykRecognize
+   takes: a fresh start symbol, terminals inside longer rules moved to
+   their own nonterminals, long rules split into pairs, then empty and
+   unit rules removed (the start keeps start -> empty when the language
+   has the empty string). */
+Grammar chomskyNormalForm(const Grammar &g) {
+    const int NT = Grammar::NT;
+    if (g.numNonterminals() == 0) return g;
+    Grammar out;
+    out.names = g.names;
+    auto fresh = [&](const string &name) {
+        out.names.push_back(name);
+        return NT + (int)out.names.size() - 1;
+    };
+    out.start = fresh(g.names[g.start - NT] + "'");
+
+    /* Terminals in rules of two or more symbols, then pairs */
+    vector<pair<int, vector<int>>> rules{{out.start, {g.start}}};
+    map<int, int> termNT;
+    for (size_t p = 0; p < g.lhs.size(); p++) {
+        vector<int> r = g.rhs[p];
+        if (r.size() >= 2)
+            for (int &sym : r) {
+                if (sym >= NT) continue;
+                auto it = termNT.find(sym);
+                if (it == termNT.end()) {
+                    it = termNT.emplace(sym, fresh(string(1, sym))).first;
+                    rules.push_back({it->second, {sym}});
+                }
+                sym = it->second;
+            }
+        int left = g.lhs[p];
+        while (r.size() > 2) {
+            int rest = fresh(out.names[left - NT] + "+");
+            rules.push_back({left, {r[0], rest}});
+            r.erase(r.begin());
+            left = rest;
+        }
+        rules.push_back({left, r});
+    }
+
+    size_t numNT = out.names.size();
+    vector<char> nullable(numNT, 0);
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (auto &[a, r] : rules) {
+            bool all = all_of(r.begin(), r.end(), [&](int sym) {
+                return sym >= NT && nullable[sym - NT];
+            });
+            if (all && !nullable[a - NT]) nullable[a - NT] = changed = true;
+        }
+    }
+
+    /* Every way of dropping nullable symbols from a pair; empty rules go */
+    set<pair<int, vector<int>>> kept;
+    vector<vector<int>> units(numNT);
+    auto keep = [&](int a, vector<int> r) {
+        if (r.size() == 1 && r[0] >= NT) units[a - NT].push_back(r[0]);
+        else kept.insert({a, move(r)});
+    };
+    for (auto &[a, r] : rules) {
+        if (r.empty()) continue;
+        keep(a, r);
+        if (r.size() == 2) {
+            if (nullable[r[0] - NT]) keep(a, {r[1]});
+            if (nullable[r[1] - NT]) keep(a, {r[0]});
+        }
+    }
+
+    /* A -> B chains: A takes the other rules of every B it reaches */
+    map<int, vector<vector<int>>> rulesOf;
+    for (auto &[a, r] : kept) rulesOf[a].push_back(r);
+    set<pair<int, vector<int>>> cnf;
+    for (size_t a = 0; a < numNT; a++) {
+        vector<char> seen(numNT, 0);
+        vector<size_t> work{a};
+        seen[a] = 1;
+        while (!work.empty()) {
+            size_t b = work.back();
+            work.pop_back();
+            for (auto &r : rulesOf[NT + (int)b]) cnf.insert({NT + (int)a, r});
+            for (int c : units[b])
+                if (!seen[c - NT]) {
+                    seen[c - NT] = 1;
+                    work.push_back(c - NT);
+                }
+        }
+    }
+    if (nullable[out.start - NT]) cnf.insert({out.start, {}});
+    for (auto &[a, r] : cnf) out.addRule(a, r);
+    return out;
+}
+
+/* CYK recognizer for grammars in Chomsky normal form (A -> B C, A -> a,
+   and start -> empty). chart[len][i] is a packed bitset of the
+   nonterminals deriving input[i, i+len). O(n^3) time and O(n^2) bitsets,
+   so this is for short inputs; throws invalid_argument on a non-CNF
+   grammar (chomskyNormalForm converts one). */
+bool cykRecognize(const Grammar &g, string_view input) {
+    size_t numNT = g.numNonterminals(), n = input.size();
+    if (numNT == 0) return false;
+
+    struct Binary { int a, b, c; };
+    vector<vector<Binary>> byLeft(numNT);
+    vector<vector<int>> byTerminal(256);
+    bool startNullable = false;
+    for (size_t p = 0; p < g.lhs.size(); p++) {
+        int a = g.lhs[p] - Grammar::NT;
+        auto &r = g.rhs[p];
+        if (r.empty() && g.lhs[p] == g.start)
+            startNullable = true;
+        else if (r.size() == 1 && r[0] < Grammar::NT)
+            byTerminal[r[0]].push_back(a);
+        else if (r.size() == 2 && r[0] >= Grammar::NT && r[1] >= Grammar::NT)
+            byLeft[r[0] - Grammar::NT].push_back(
+                {a, r[0] - Grammar::NT, r[1] - Grammar::NT});
+        else
+            throw invalid_argument("grammar is not in Chomsky normal form");
+    }
+    if (n == 0) return startNullable;
+
+    size_t words = (numNT + 63) / 64;
+    /* Row for length len starts at rowStart(len); it has n - len + 1 cells */
+    auto rowStart = [&](size_t len) {
+        return (len - 1) * n - (len - 1) * (len - 2) / 2;
+    };
+    vector<uint64_t> chart(rowStart(n + 1) * words, 0);
+    auto cell = [&](size_t len, size_t i) {
+        return &chart[(rowStart(len) + i) * words];
+    };
+    auto has = [](const uint64_t *c, int a) { return c[a >> 6] >> (a & 63) & 1; };
+
+    for (size_t i = 0; i < n; i++)
+        for (int a : byTerminal[(unsigned char)input[i]])
+            cell(1, i)[a >> 6] |= uint64_t(1) << (a & 63);
+
+    for (size_t len = 2; len <= n; len++)
+        for (size_t i = 0; i + len <= n; i++) {
+            uint64_t *out = cell(len, i);
+            for (size_t k = 1; k < len; k++) {
+                const uint64_t *left = cell(k, i), *right = cell(len - k, i + k);
+                for (size_t w = 0; w < words; w++)
+                    for (uint64_t bits = left[w]; bits; bits &= bits - 1) {
+                        int b = w * 64 + __builtin_ctzll(bits);
+                        for (auto &r : byLeft[b])
+                            if (has(right, r.c))
+                                out[r.a >> 6] |= uint64_t(1) << (r.a & 63);
+                    }
+            }
+        }
+
+    return has(cell(n, 0), g.start - Grammar::NT);
+}
+
+/* ====================== Mapped Input ====================== */
+/* Read-only view of a whole file. On POSIX the file is mmapped with
+   MADV_SEQUENTIAL, so multi-GB inputs are scanned without being copied
+   into a string; elsewhere it falls back to reading into memory. */
+class MappedFile {
+public:
+    /* Throws runtime_error if the file cannot be opened or mapped */
+    explicit MappedFile(const string &path) {
+#ifdef _WIN32
+        ifstream in(path, ios::binary);
+        if (!in) throw runtime_error("cannot open " + path);
+        fallback.assign(istreambuf_iterator<char>(in),
+                        istreambuf_iterator<char>());
+        data = fallback.data();
+        size = fallback.size();
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw runtime_error("cannot open " + path + ": " + strerror(errno));
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            int err = errno;
+            close(fd);
+            throw runtime_error("cannot stat " + path + ": " + strerror(err));
+        }
+        size = st.st_size;
+        if (size > 0) {
+            void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                int err = errno;
+                close(fd);
+                throw runtime_error("cannot map " + path + ": " +
+                                    strerror(err));
+            }
+            madvise(p, size, MADV_SEQUENTIAL);
+            data = static_cast<const char *>(p);
+        }
+        close(fd);   /* the mapping stays valid */
+#endif
+    }
+
+    ~MappedFile() {
+#ifndef _WIN32
+        if (data) munmap(const_cast<char *>(data), size);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    string_view view() const { return string_view(data, size); }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    string fallback;
+#endif
+};
+
+/* ====================== Compiled DFA Files ====================== */
+/* On-disk FlatDFA: a fixed header followed by the transition table at a
+   64-byte aligned offset, in native byte order and the table's own id
+   width. Loading maps the file and points the FlatDFA straight at it,
+   so startup does no parsing and no copying beyond the header. Every
+   table entry is checked on load unless verify is false, an opt-in for
+   files the caller wrote itself.
+   Version 2 numbers accepting states first instead of storing a final
+   bitset; version 1 files must be recompiled. */
+static const char FLAT_DFA_MAGIC[8] = {'S', 'S', 'D', 'F', 'A', 0, 0, 0};
+static const uint32_t FLAT_DFA_VERSION = 2;
+static const uint32_t FLAT_DFA_ENDIAN = 0x01020304;
+
+struct FlatDFAHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t numStates;
+    uint32_t numFinal;
+    uint32_t startState;
+    uint32_t deadState;
+    uint32_t stride;
+    uint32_t idBytes;            /* 2 or 4 */
+    uint64_t tableOffset, tableBytes;
+    uint8_t classOf[256];
+};
+
+static uint64_t alignUp64(uint64_t x) { return (x + 63) & ~uint64_t(63); }
+
+/* Throws runtime_error on I/O failure */
+void saveFlatDFA(const FlatDFA &dfa, const string &path) {
+    FlatDFAHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, FLAT_DFA_MAGIC, sizeof h.magic);
+    h.version = FLAT_DFA_VERSION;
+    h.endian = FLAT_DFA_ENDIAN;
+    h.numStates = dfa.numStates;
+    h.numFinal = dfa.numFinal;
+    h.startState = dfa.startState;
+    h.deadState = dfa.deadState;
+    h.stride = dfa.stride;
+    h.idBytes = dfa.idBytes();
+    h.tableBytes = dfa.memoryBytes();
+    h.tableOffset = alignUp64(sizeof h);
+    memcpy(h.classOf, dfa.classes.classOf.data(), 256);
+
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) throw runtime_error("cannot create " + path);
+    static const char zeros[64] = {0};
+    out.write(reinterpret_cast<const char *>(&h), sizeof h);
+    out.write(zeros, h.tableOffset - sizeof h);
+    dfa.withTable([&](auto *t) {
+        out.write(reinterpret_cast<const char *>(t), h.tableBytes);
+    });
+    if (!out.flush()) throw runtime_error("cannot write " + path);
+}
+
+/* Throws runtime_error if the file is missing, truncated or from an
+   incompatible version */
+FlatDFA loadFlatDFA(const string &path, bool verify = true) {
+    auto file = make_shared<MappedFile>(path);
+    string_view bytes = file->view();
+    auto bad = [&](const string &why) {
+        return runtime_error(path + ": " + why);
+    };
+
+    FlatDFAHeader h;
+    if (bytes.size() < sizeof h) throw bad("truncated header");
+    memcpy(&h, bytes.data(), sizeof h);
+    if (memcmp(h.magic, FLAT_DFA_MAGIC, sizeof h.magic) != 0)
+        throw bad("not a compiled DFA");
+    if (h.version != FLAT_DFA_VERSION)
+        throw bad("unsupported version " + to_string(h.version));
+    if (h.endian != FLAT_DFA_ENDIAN) throw bad("wrong byte order");
+    /* Every row takes at least two bytes, which bounds numStates by the
+       file size before any size arithmetic. The id width is the one
+       adopt() would pick. */
+    if (h.numStates >= bytes.size() / 2) throw bad("corrupt header");
+    uint32_t idBytes = h.numStates < 0x10000 ? 2 : 4;
+    if (h.stride == 0 || h.stride > 256 || h.deadState != h.numStates ||
+        h.startState > h.numStates || h.numFinal > h.numStates ||
+        h.idBytes != idBytes ||
+        h.tableBytes != ((uint64_t)h.numStates + 1) * h.stride * idBytes ||
+        h.tableOffset % 64 || h.tableOffset < sizeof h ||
+        h.tableOffset > bytes.size() ||
+        h.tableBytes > bytes.size() - h.tableOffset)
+        throw bad("corrupt header");
+
+    FlatDFA dfa;
+    for (int b = 0; b < 256; b++) {
+        if (h.classOf[b] >= h.stride) throw bad("corrupt byte classes");
+        dfa.classes.classOf[b] = h.classOf[b];
+    }
+    dfa.classes.numClasses = h.stride;
+    dfa.stride = h.stride;
+    dfa.numStates = h.numStates;
+    dfa.numFinal = h.numFinal;
+    dfa.startState = h.startState;
+    dfa.deadState = h.deadState;
+    const char *table = bytes.data() + h.tableOffset;
+    if (idBytes == 2)
+        dfa.table16 = reinterpret_cast<const uint16_t *>(table);
+    else
+        dfa.table32 = reinterpret_cast<const uint32_t *>(table);
+
+    if (verify)
+        dfa.withTable([&](auto *t) {
+            for (uint64_t i = 0; i < h.tableBytes / idBytes; i++)
+                if (t[i] > h.numStates) throw bad("corrupt table");
+        });
+
+    dfa.storage = file;
+    return dfa;
+}
+
+/* ====================== Pattern Cache ====================== */
+/* Compiled automata shared across queries and threads, keyed by pattern
+   text plus options. Keys are spread over shards by hash. A hit takes
+   only its shard's lock in shared mode and flags the entry as recently
+   used, so concurrent readers never wait on each other. A miss compiles
+   outside any lock, then inserts under the exclusive lock, evicting by
+   CLOCK (second-chance LRU) until the shard is back within its share of
+   the memory budget. Two threads missing on the same pattern may both
+   compile it; the first insert wins. Hits, misses and evictions are
+   counted in the engine stats. */
+struct PatternOptions {
+    bool minimize = true;
+    bool search = false;     /* also build a Searcher */
+    int approxErrors = -1;   /* >= 0: also build an ApproxRegex with it */
+};
+
+struct CompiledPattern {
+    FlatDFA dfa;                          /* whole-input match */
+    unique_ptr<const Searcher> searcher;  /* with PatternOptions::search */
+    unique_ptr<const ApproxRegex> approx; /* with approxErrors >= 0 */
+    size_t bytes = 0;                     /* charged against the budget */
+};
+
+class PatternCache {
+public:
+    explicit PatternCache(size_t budgetBytes = 256 << 20, size_t shards = 16)
+        : shardBudget(budgetBytes / max<size_t>(shards, 1)),
+          shards(max<size_t>(shards, 1)) {
+        for (auto &sh : this->shards) sh = make_unique<Shard>();
+    }
+
+    /* Throws invalid_argument on a malformed pattern */
+    shared_ptr<const CompiledPattern> get(string_view pattern,
+                                          PatternOptions opt = {}) {
+        thread_local string key;
+        key.assign(1, (char)('0' + opt.minimize + 2 * opt.search));
+        if (opt.approxErrors >= 0) key += to_string(opt.approxErrors);
+        key += ':';
+        key.append(pattern);
+        Shard &sh = *shards[hash<string>{}(key) % shards.size()];
+
+        {
+            shared_lock<shared_mutex> g(sh.lock);
+            auto it = sh.index.find(key);
+            if (it != sh.index.end()) {
+                statAdd(StatPatternHits, 1);
+                return touch(*sh.ring[it->second]);
+            }
+        }
+        statAdd(StatPatternMisses, 1);
+
+        auto p = make_shared<CompiledPattern>();
+        {
+            Arena arena;
+            NFA nfa = regexToNFA(string(pattern), &arena);
+            p->dfa = compileDFA(nfaToDFA(nfa, &arena), opt.minimize);
+            if (opt.search) p->searcher = make_unique<Searcher>(nfa);
+            if (opt.approxErrors >= 0)
+                p->approx = make_unique<ApproxRegex>(nfa, opt.approxErrors);
+        }
+        p->bytes = sizeof(CompiledPattern) + key.size() +
+                   p->dfa.memoryBytes() +
+                   (p->searcher ? p->searcher->memoryBytes() : 0) +
+                   (p->approx ? p->approx->memoryBytes() : 0);
+        /* Too big to ever fit: hand it out without caching */
+        if (p->bytes > shardBudget) return p;
+
+        unique_lock<shared_mutex> g(sh.lock);
+        auto it = sh.index.find(key);
+        if (it != sh.index.end()) return touch(*sh.ring[it->second]);
+        evict(sh, p->bytes);
+
+        uint32_t slot = sh.ring.size();
+        if (!sh.freeSlots.empty()) {
+            slot = sh.freeSlots.back();
+            sh.freeSlots.pop_back();
+        } else {
+            sh.ring.emplace_back();
+        }
+        sh.ring[slot] = make_unique<Entry>(key, p);
+        sh.index.emplace(sh.ring[slot]->key, slot);
+        sh.bytes += p->bytes;
+        return p;
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (auto &sh : shards) {
+            shared_lock<shared_mutex> g(sh->lock);
+            n += sh->index.size();
+        }
+        return n;
+    }
+
+    size_t memoryBytes() const {
+        size_t n = 0;
+        for (auto &sh : shards) {
+            shared_lock<shared_mutex> g(sh->lock);
+            n += sh->bytes;
+        }
+        return n;
+    }
+
+    void clear() {
+        for (auto &sh : shards) {
+            unique_lock<shared_mutex> g(sh->lock);
+            sh->index.clear();
+            sh->ring.clear();
+            sh->freeSlots.clear();
+            sh->hand = sh->bytes = 0;
+        }
+    }
+
+private:
+    struct Entry {
+        string key;
+        shared_ptr<const CompiledPattern> value;
+        atomic<bool> referenced{true};
+
+        Entry(const string &key, shared_ptr<const CompiledPattern> value)
+            : key(key), value(std::move(value)) {}
+    };
+
+    /* Own cache line each, so shards do not false-share their locks */
+    struct alignas(64) Shard {
+        mutable shared_mutex lock;
+        unordered_map<string_view, uint32_t> index;   /* views Entry::key */
+        vector<unique_ptr<Entry>> ring;               /* null: free slot */
+        vector<uint32_t> freeSlots;
+        size_t hand = 0;
+        size_t bytes = 0;
+    };
+
+    size_t shardBudget;
+    vector<unique_ptr<Shard>> shards;
+
+    /* Only writes the flag when it changes, so hot entries stay clean */
+    static shared_ptr<const CompiledPattern> touch(Entry &e) {
+        if (!e.referenced.load(memory_order_relaxed))
+            e.referenced.store(true, memory_order_relaxed);
+        return e.value;
+    }
+
+    /* CLOCK sweep: a referenced entry loses its flag and survives one
+       more pass, an unreferenced one is dropped */
+    void evict(Shard &sh, size_t need) {
+        while (sh.bytes + need > shardBudget && !sh.index.empty()) {
+            if (sh.hand >= sh.ring.size()) sh.hand = 0;
+            unique_ptr<Entry> &e = sh.ring[sh.hand];
+            if (e && !e->referenced.exchange(false, memory_order_relaxed)) {
+                sh.bytes -= e->value->bytes;
+                sh.index.erase(e->key);
+                e.reset();
+                sh.freeSlots.push_back(sh.hand);
+                statAdd(StatPatternEvictions, 1);
+            }
+            sh.hand++;
+        }
+    }
+};
+
+/* ====================== Query Server ====================== */
+/* Long-lived request loop: patterns are compiled on first use and kept,
+   so a request only pays for matching. A request is tab-separated
+   fields; the last one runs to the end of the request, so the text may
+   contain tabs:
+       match <regex> <text>          1 | 0, whole-text match
+       search <regex> <text>         <count> [<start> <end> of the first]
+       approx <k> <regex> <text>     1 | 0, a substring within k edits
+       anbn <text>                   1 | 0
+       balanced <pairs> <text>       1 | 0, e.g. pairs "()[]"
+       stats                         counters as one JSON line
+   Requests are framed one per line, or with lengthPrefixed as a decimal
+   byte count and '\n' followed by that many bytes (so texts may contain
+   newlines). Every request gets exactly one response line, "ERR ..." on
+   failure. Responses are collected while buffered input remains and
+   written with one write per read. Use one QueryServer per connection;
+   they can share a PatternCache. */
+class QueryServer {
+public:
+    explicit QueryServer(PatternCache &cache, bool lengthPrefixed = false)
+        : cache(cache), lengthPrefixed(lengthPrefixed) {}
+
+    /* Serves until end of input; false on a read/write error or a
+       malformed length prefix */
+    bool serve(int in, int out) {
+        string buf, responses;
+        vector<char> chunk(1 << 16);
+        for (;;) {
+            auto got = read(in, chunk.data(), chunk.size());
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0) return false;
+            if (got == 0) break;
+            buf.append(chunk.data(), got);
+
+            size_t pos = 0;
+            string_view request;
+            Frame f;
+            while ((f = nextRequest(buf, pos, request)) == Complete)
+                respond(request, responses);
+            if (f == Malformed) responses += "ERR malformed length prefix\n";
+            buf.erase(0, pos);
+            if (!writeAll(out, responses) || f == Malformed) return false;
+            responses.clear();
+        }
+        /* A last line without its newline */
+        if (!lengthPrefixed && !buf.empty()) {
+            respond(buf, responses);
+            return writeAll(out, responses);
+        }
+        return buf.empty();
+    }
+
+    string handle(string_view request) {
+        auto field = [&] {
+            size_t tab = request.find('\t');
+            string_view f = request.substr(0, tab);
+            request = tab == string_view::npos ? string_view()
+                                               : request.substr(tab + 1);
+            return f;
+        };
+        string_view cmd = field();
+        try {
+            if (cmd == "match") {
+                auto p = cache.get(field());
+                return p->dfa.simulate(request) ? "1" : "0";
+            }
+            if (cmd == "search") {
+                PatternOptions opt;
+                opt.search = true;
+                auto p = cache.get(field(), opt);
+                Match first{0, 0};
+                size_t n = 0;
+                p->searcher->forEach(request, [&](const Match &m) {
+                    if (n++ == 0) first = m;
+                });
+                if (!n) return "0";
+                return to_string(n) + " " + to_string(first.start) + " " +
+                       to_string(first.end);
+            }
+            if (cmd == "approx") {
+                string_view k = field();
+                int maxErrors;
+                auto [end, err] = from_chars(k.data(), k.data() + k.size(),
+                                             maxErrors);
+                if (k.empty() || err != errc() || end != k.data() + k.size() ||
+                    maxErrors < 0)
+                    return "ERR invalid edit distance";
+                PatternOptions opt;
+                opt.approxErrors = maxErrors;
+                auto p = cache.get(field(), opt);
+                return p->approx->match(request) ? "1" : "0";
+            }
+            if (cmd == "anbn") return anbn.simulate(request) ? "1" : "0";
+            if (cmd == "balanced") {
+                string pairs(field());
+                auto it = pdas.find(pairs);
+                if (it == pdas.end())
+                    it = pdas.emplace(pairs, PDA::balanced(pairs)).first;
+                return it->second.simulate(request) ? "1" : "0";
+            }
+            if (cmd == "stats") return statsJSON();
+            return "ERR unknown command";
+        } catch (const exception &e) {
+            return string("ERR ") + e.what();
+        }
+    }
+
+private:
+    PatternCache &cache;
+    bool lengthPrefixed;
+    map<string, PDA> pdas;
+    PDA anbn = PDA::anbn();
+
+    void respond(string_view request, string &out) {
+        out += handle(request);
+        out += '\n';
+    }
+
+    enum Frame { Complete, Partial, Malformed };
+
+    /* Request starting at buf[pos]; pos moves past it only if Complete */
+    Frame nextRequest(string_view buf, size_t &pos, string_view &request) {
+        size_t nl = buf.find('\n', pos);
+        if (nl == string_view::npos) return Partial;
+        if (!lengthPrefixed) {
+            size_t end = nl > pos && buf[nl - 1] == '\r' ? nl - 1 : nl;
+            request = buf.substr(pos, end - pos);
+            pos = nl + 1;
+            return Complete;
+        }
+        if (nl == pos) return Malformed;
+        size_t len = 0;
+        for (size_t i = pos; i < nl; i++) {
+            if (buf[i] < '0' || buf[i] > '9' || len > (SIZE_MAX - 9) / 10)
+                return Malformed;
+            len = len * 10 + (buf[i] - '0');
+        }
+        if (buf.size() - (nl + 1) < len) return Partial;
+        request = buf.substr(nl + 1, len);
+        pos = nl + 1 + len;
+        return Complete;
+    }
+
+    static bool writeAll(int fd, const string &data) {
+        for (size_t done = 0; done < data.size(); ) {
+            auto n = write(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += n;
+        }
+        return true;
+    }
+};
+
+/* ====================== MAIN ====================== */
+/* Define SEARCHSYSTEM_NO_MAIN to use this file as a library, as
+   bench/searchsystem_bench.cpp and tests/searchsystem_test.cpp do */
+#ifndef SEARCHSYSTEM_NO_MAIN
+
+/* scan <regex> <file> [maxErrors]: match one pattern against a whole
+   file through a memory-mapped view */
+static int runScan(const string &regex, const string &path, int maxErrors) {
+    NFA nfa;
+    try {
+        nfa = regexToNFA(regex);
+    } catch (const invalid_argument &e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+    FlatDFA flat = compileDFA(nfaToDFA(nfa), true);
+
+    try {
+        MappedFile file(path);
+        string_view text = file.view();
+        cout << "Scanned " << text.size() << " bytes\n";
+
+        /* Whole-file match ignores the final line break */
+        string_view body = text;
+        if (!body.empty() && body.back() == '\n') body.remove_suffix(1);
+        if (!body.empty() && body.back() == '\r') body.remove_suffix(1);
+        cout << (flat.simulate(body) ? "DFA ACCEPT\n" : "DFA REJECT\n");
+
+        Searcher searcher(nfa);
+        Match first;
+        if (searcher.findFirst(text, first))
+            cout << "Matches: " << searcher.count(text)
+                 << " (first at " << first.start
+                 << ".." << first.end << ")\n";
+        else
+            cout << "No match\n";
+
+        size_t hits = 0, firstEnd = 0;
+        ApproxRegex approx(nfa, maxErrors, true);
+        approx.scan(text, [&](size_t end, int) {
+            if (hits++ == 0) firstEnd = end;
+        });
+        if (hits)
+            cout << "Approximate matches: " << hits
+                 << " (first ends at " << firstEnd << ")\n";
+        else
+            cout << "No approximate match\n";
+    } catch (const runtime_error &e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+static int runInteractive() {
+    cout << "=== Formal Language Simulator ===\n";
+
+    string regex;
+    cout << "\nEnter regex (| * + ? [] . ()): ";
+    cin >> regex;
+
+    NFA nfa;
+    try {
+        nfa = regexToNFA(regex);
+    } catch (const invalid_argument &e) {
+        cout << e.what() << "\n";
+        return 1;
+    }
+    nfa.printTransitions();
+
+    DFA dfa = nfaToDFA(nfa);
+    dfa.printTransitions();
+
+    MinimizeStats ms;
+    DFA minDfa = minimizeDFA(dfa, &ms);
+    cout << "Minimized DFA: " << ms.statesBefore << " -> "
+         << ms.statesAfter << " states\n";
+
+    FlatDFA flat = compileDFA(minDfa);
+
+    string test;
+    cout << "\nEnter string for exact match: ";
+    cin >> test;
+
+    cout << (nfa.simulate(test) ? "NFA ACCEPT\n" : "NFA REJECT\n");
+    cout << (flat.simulate(test) ? "DFA ACCEPT\n" : "DFA REJECT\n");
+
+    string dna;
+    cout << "\nEnter DNA sequence for approximate matching: ";
+    cin >> dna;
+
+    if (ApproxRegex(nfa, 1).match(dna))
+        cout << "Approximate match found\n";
+    else
+        cout << "No approximate match\n";
+
+    /* PDA Section */
+    PDA pda = PDA::anbn();
+    string cfl;
+    cout << "\nEnter string for PDA test (a^n b^n): ";
+    cin >> cfl;
+
+    cout << (pda.simulate(cfl)
+            ? "PDA ACCEPT (Context-Free Language)\n"
+            : "PDA REJECT\n");
+
+    return 0;
+}
+
+/* compile <regex> <out>: save the minimized DFA for later `match` runs */
+static int runCompile(const string &regex, const string &path) {
+    try {
+        FlatDFA flat = compileRegex(regex);
+        saveFlatDFA(flat, path);
+        cout << "Saved " << flat.numStates << " states, " << flat.stride
+             << " byte classes to " << path << "\n";
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+/* serve [--length-prefixed] [--socket PATH] [--cache-mb N]: answer
+   QueryServer requests on stdin/stdout, or on a Unix socket with one
+   thread per connection and a shared pattern cache */
+static int runServe(bool lengthPrefixed, const string &socketPath,
+                    size_t cacheBytes) {
+    static PatternCache cache(cacheBytes);
+    if (socketPath.empty())
+        return QueryServer(cache, lengthPrefixed).serve(0, 1) ? 0 : 1;
+#ifdef _WIN32
+    cerr << "socket mode is only available on POSIX systems\n";
+    return 1;
+#else
+    signal(SIGPIPE, SIG_IGN);   /* a client that hangs up is not fatal */
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof addr.sun_path) {
+        cerr << "socket path too long: " << socketPath << "\n";
+        return 1;
+    }
+    memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof addr) < 0 ||
+        listen(fd, 64) < 0) {
+        cerr << "cannot listen on " << socketPath << ": " << strerror(errno)
+             << "\n";
+        return 1;
+    }
+    for (;;) {
+        int client = accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            cerr << "accept: " << strerror(errno) << "\n";
+            return 1;
+        }
+        thread([client, lengthPrefixed] {
+            QueryServer(cache, lengthPrefixed).serve(client, client);
+            close(client);
+        }).detach();
+    }
+#endif
+}
+
+/* match <compiled> <file>: whole-file match with a saved DFA */
+static int runMatch(const string &dfaPath, const string &path) {
+    try {
+        FlatDFA flat = loadFlatDFA(dfaPath);
+        MappedFile file(path);
+        string_view body = file.view();
+        if (!body.empty() && body.back() == '\n') body.remove_suffix(1);
+        if (!body.empty() && body.back() == '\r') body.remove_suffix(1);
+        cout << (flat.simulate(body) ? "DFA ACCEPT\n" : "DFA REJECT\n");
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    string mode = argc > 1 ? argv[1] : "";
+    if (argc >= 4 && mode == "scan")
+        return runScan(argv[2], argv[3], argc >= 5 ? atoi(argv[4]) : 1);
+    if (argc == 4 && mode == "compile") return runCompile(argv[2], argv[3]);
+    if (argc == 4 && mode == "match") return runMatch(argv[2], argv[3]);
+    if (mode == "serve") {
+        bool lengthPrefixed = false;
+        string socketPath;
+        size_t cacheMB = 256;
+        bool ok = true;
+        for (int i = 2; i < argc && ok; i++) {
+            string a = argv[i];
+            if (a == "--length-prefixed") lengthPrefixed = true;
+            else if (a == "--socket" && i + 1 < argc) socketPath = argv[++i];
+            else if (a == "--cache-mb" && i + 1 < argc)
+                cacheMB = atol(argv[++i]);
+            else ok = false;
+        }
+        if (ok) return runServe(lengthPrefixed, socketPath, cacheMB << 20);
+    }
+    if (argc > 1) {
+        cerr << "usage: " << argv[0] << "\n"
+             << "       " << argv[0] << " scan <regex> <file> [maxErrors]\n"
+             << "       " << argv[0] << " compile <regex> <out.dfa>\n"
+             << "       " << argv[0] << " match <compiled.dfa> <file>\n"
+             << "       " << argv[0]
+             << " serve [--length-prefixed] [--socket PATH] [--cache-mb N]\n";
+        return 2;
+    }
+    return runInteractive();
+}
+
+#endif /* SEARCHSYSTEM_NO_MAIN */
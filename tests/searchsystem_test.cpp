@@ -0,0 +1,1218 @@
+/* Regression tests for the searchsystem.cpp engines.
+
+   Build and run from the repository root:
+       g++ -std=c++17 -O2 -pthread -o searchsystem_test \
+           tests/searchsystem_test.cpp && ./searchsystem_test
+
+   Each check prints a line only when it fails; the exit status is the
+   number of failed checks. Regexes are checked against a reference
+   matcher that walks the parsed AST directly, so every automaton built
+   from the Thompson NFA is held to the same answer. */
+#define SEARCHSYSTEM_NO_MAIN
+#include "../searchsystem.cpp"
+
+#include <cstdio>
+#include <random>
+
+static bool operator==(const Match &a, const Match &b) {
+    return a.start == b.start && a.end == b.end;
+}
+
+namespace {
+
+constexpr char PRIMER[] = "ACGTTGCA";
+
+/* Built and run entirely by the compiler */
+constexpr auto primerDFA = makeStaticDFA("ACGTTGCA");
+static_assert(primerDFA.simulate("ACGTTGCA"));
+static_assert(!primerDFA.simulate("ACGTTGC"));
+static_assert(!primerDFA.simulate("ACGTTGCAA"));
+static_assert(StaticLiteral<PRIMER>::simulate("ACGTTGCA"));
+
+int failures = 0;
+
+void check(bool ok, const string &what) {
+    if (ok) return;
+    failures++;
+    printf("FAIL %s\n", what.c_str());
+}
+
+/* The minimized flat DFA for regex */
+FlatDFA compileFlat(const string &regex) {
+    return compileDFA(nfaToDFA(regexToNFA(regex)), true);
+}
+
+string randomDNA(mt19937 &rng, size_t n) {
+    string s(n, 'A');
+    for (char &c : s) c = "ACGT"[rng() % 4];
+    return s;
+}
+
+/* n random bases, half the time with a copy of pattern spliced in after
+   up to three random edits, so both answers come up */
+string approxText(mt19937 &rng, const string &pattern, size_t n) {
+    string text = randomDNA(rng, n), copy = pattern;
+    if (rng() % 2) return text;
+    for (int e = rng() % 4; e > 0; e--) {
+        size_t at = rng() % (copy.size() + 1);
+        char base = "ACGT"[rng() % 4];
+        switch (rng() % 3) {
+        case 0: copy.insert(copy.begin() + at, base); break;
+        case 1: if (at < copy.size()) copy.erase(at, 1); break;
+        default: if (at < copy.size()) copy[at] = base; break;
+        }
+    }
+    text.insert(rng() % (text.size() + 1), copy);
+    return text;
+}
+
+/* Every end i >= m with dp[i][m] <= k, in order, with dp[i][m] */
+vector<pair<size_t, int>> refApproxEnds(string_view text,
+                                        string_view pattern, int k) {
+    size_t m = pattern.size();
+    vector<pair<size_t, int>> out;
+    vector<int> col(m + 1);
+    for (size_t j = 0; j <= m; j++) col[j] = j;
+    for (size_t i = 1; i <= text.size(); i++) {
+        int diag = col[0];
+        col[0] = 0;
+        for (size_t j = 1; j <= m; j++) {
+            int up = col[j];
+            col[j] = text[i-1] == pattern[j-1]
+                   ? diag : 1 + min({diag, up, col[j-1]});
+            diag = up;
+        }
+        if (i >= m && col[m] <= k) out.push_back({i, col[m]});
+    }
+    return out;
+}
+
+/* ---------- reference regex matcher ---------- */
+
+/* Every position at which node n, started at position i, can end */
+set<size_t> refEnds(const vector<RegexNode> &nodes, int n, string_view s,
+                    size_t i) {
+    const RegexNode &node = nodes[n];
+    set<size_t> out;
+    switch (node.kind) {
+    case RegexNode::Empty:
+        out.insert(i);
+        break;
+    case RegexNode::Symbols:
+        if (i < s.size() && node.symbols[(unsigned char)s[i]])
+            out.insert(i + 1);
+        break;
+    case RegexNode::Concat: {
+        out.insert(i);
+        for (int child : node.children) {
+            set<size_t> next;
+            for (size_t j : out)
+                for (size_t e : refEnds(nodes, child, s, j)) next.insert(e);
+            out = move(next);
+        }
+        break;
+    }
+    case RegexNode::Alt:
+        for (int child : node.children)
+            for (size_t e : refEnds(nodes, child, s, i)) out.insert(e);
+        break;
+    case RegexNode::Opt:
+        out.insert(i);
+        /* fall through */
+    case RegexNode::Plus:
+    case RegexNode::Star: {
+        if (node.kind == RegexNode::Star) out.insert(i);
+        vector<size_t> work{i};
+        set<size_t> seen{i};
+        while (!work.empty()) {
+            size_t j = work.back();
+            work.pop_back();
+            for (size_t e : refEnds(nodes, node.children[0], s, j)) {
+                out.insert(e);
+                if (node.kind != RegexNode::Opt && seen.insert(e).second)
+                    work.push_back(e);
+            }
+        }
+        break;
+    }
+    }
+    return out;
+}
+
+bool refMatch(const string &regex, string_view s) {
+    vector<RegexNode> nodes;
+    int root = RegexParser(regex).parse(nodes);
+    return refEnds(nodes, root, s, 0).count(s.size()) > 0;
+}
+
+bool refSearch(const string &regex, string_view s) {
+    vector<RegexNode> nodes;
+    int root = RegexParser(regex).parse(nodes);
+    for (size_t i = 0; i <= s.size(); i++)
+        if (!refEnds(nodes, root, s, i).empty()) return true;
+    return false;
+}
+
+/* Leftmost-longest, non-overlapping, resuming a byte after empty
+   matches */
+vector<Match> refFindAll(const string &regex, string_view s) {
+    vector<RegexNode> nodes;
+    int root = RegexParser(regex).parse(nodes);
+    vector<Match> out;
+    for (size_t i = 0; i <= s.size(); i++) {
+        set<size_t> ends = refEnds(nodes, root, s, i);
+        if (ends.empty()) continue;
+        out.push_back({i, *ends.rbegin()});
+        if (*ends.rbegin() > i) i = *ends.rbegin() - 1;
+    }
+    return out;
+}
+
+/* Runs text through every whole-match engine and the substring
+   engines, and compares each with the reference */
+void checkRegex(const string &regex, const string &text) {
+    string what = "/" + regex + "/ on \"" + text + "\"";
+    bool want = refMatch(regex, text);
+    NFA nfa = regexToNFA(regex);
+    DFA dfa = nfaToDFA(nfa);
+    check(nfa.simulate(text) == want, "NFA " + what);
+    check(dfa.simulate(text) == want, "DFA " + what);
+    check(minimizeDFA(dfa).simulate(text) == want, "minimized DFA " + what);
+    check(compileDFA(dfa, true).simulate(text) == want, "flat DFA " + what);
+    check(LazyDFA(nfa).simulate(text) == want, "lazy DFA " + what);
+    check(compileBitNFA(nfa).simulate(text) == want, "bit NFA " + what);
+
+    Searcher searcher(nfa);
+    check(searcher.findAll(text) == refFindAll(regex, text),
+          "Searcher " + what);
+    /* ApproxRegex reports ends after at least one byte */
+    if (!text.empty())
+        check(ApproxRegex(nfa, 0).match(text) == refSearch(regex, text),
+              "ApproxRegex " + what);
+}
+
+/* Random regex over the bytes of alphabet, with '.' and, if classes
+   is set, bracket classes of them */
+string randomRegex(mt19937 &rng, int depth, const string &alphabet,
+                   bool classes = false) {
+    auto pick = [&](size_t n) { return (size_t)(rng() % n); };
+    auto sym = [&]() -> string {
+        size_t k = pick(alphabet.size() + 1 + 2 * classes);
+        if (k < alphabet.size()) return string(1, alphabet[k]);
+        if (k == alphabet.size()) return ".";
+        string cls = k == alphabet.size() + 1 ? "[" : "[^";
+        cls += alphabet[pick(alphabet.size())];
+        cls += alphabet[pick(alphabet.size())];
+        return cls + "]";
+    };
+    switch (depth ? pick(7) : pick(2)) {
+    case 0: case 1: return sym();
+    case 2:
+        return randomRegex(rng, depth - 1, alphabet, classes) +
+               randomRegex(rng, depth - 1, alphabet, classes);
+    case 3:
+        return "(" + randomRegex(rng, depth - 1, alphabet, classes) + "|" +
+               randomRegex(rng, depth - 1, alphabet, classes) + ")";
+    case 4: return "(" + randomRegex(rng, depth - 1, alphabet, classes) + ")*";
+    case 5: return "(" + randomRegex(rng, depth - 1, alphabet, classes) + ")+";
+    default:
+        return "(" + randomRegex(rng, depth - 1, alphabet, classes) + ")?";
+    }
+}
+
+/* ---------- cases ---------- */
+
+/* An optional or repeated group must be skippable without entering the
+   loop state at the end of its body */
+void testOptionalGroups() {
+    const char *cases[][2] = {
+        {"(ab*)?", "b"},   {"(ab*)?", ""},     {"(ab*)?", "abb"},
+        {"(ba+)?", "a"},   {"(ba+)?", "baa"},  {"(ab*)?c", "bc"},
+        {"(ab*)?c", "c"},  {"(ab*)?c", "abc"}, {"z(ab*)?", "zb"},
+        {"z(ab*)?", "zab"}, {"(ab*)+c", "bc"}, {"(ab*)+c", "abbac"},
+        {"(a*b)?a", "ba"}, {"(a|b*)?c", "bbc"}, {"((ab*)?)*", "bab"},
+    };
+    for (auto &c : cases) checkRegex(c[0], c[1]);
+}
+
+/* Random small regexes over {a,b,c} against random short texts */
+void testRandomRegexes() {
+    mt19937 rng(3);
+    for (int i = 0; i < 400; i++) {
+        string regex = randomRegex(rng, 3, "abc");
+        for (int j = 0; j < 8; j++) {
+            string text(rng() % 6, 'a');
+            for (char &c : text) c = "abc"[rng() % 3];
+            checkRegex(regex, text);
+        }
+    }
+}
+
+/* A cache of two or three subsets keeps flushing on a pattern whose full
+   DFA is exponential, and must still agree with it */
+void testLazyDFAFlush() {
+    NFA nfa = regexToNFA("(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)");
+    DFA full = nfaToDFA(nfa);
+    mt19937 rng(5);
+    for (size_t maxStates : {2, 3}) {
+        LazyDFA lazy(nfa, maxStates);
+        bool same = true;
+        for (int i = 0; i < 300; i++) {
+            string text(rng() % 40, 'a');
+            for (char &c : text) c = "abbc"[rng() % (i % 10 ? 3 : 4)];
+            same = same && lazy.simulate(text) == full.simulate(text);
+            same = same && lazy.cachedStates() <= maxStates;
+        }
+        check(same && lazy.flushCount() > 0,
+              "LazyDFA with " + to_string(maxStates) + " cached states");
+    }
+}
+
+/* The exact approximate matchers against the reference dp, across the
+   64-bit word boundary and with k = 0 and k >= m */
+void testApproxMatchers() {
+    mt19937 rng(8);
+    for (size_t m : {1, 2, 7, 31, 63, 64, 65, 100, 128, 129, 200}) {
+        for (int round = 0; round < 12; round++) {
+            string pattern = randomDNA(rng, m);
+            string text = approxText(rng, pattern, rng() % 300);
+            for (int k : {-1, 0, 1, 2, 3, (int)m / 4, (int)m - 1, (int)m,
+                          (int)m + 1}) {
+                bool want = approximateMatchDP(text, pattern, k);
+                string what = "m " + to_string(m) + " k " + to_string(k) +
+                              " on \"" + text + "\"";
+                check(approximateMatchMyers(text, pattern, k) == want,
+                      "Myers " + what);
+                check(approximateMatchWuManber(text, pattern, k) == want,
+                      "Wu-Manber " + what);
+                check(approximateMatchUkkonen(text, pattern, k) == want,
+                      "Ukkonen " + what);
+                check(approximateMatchFiltered(text, pattern, k) == want,
+                      "filtered " + what);
+                check(approximateMatchFiltered(text, pattern, k,
+                                               verifyWindowScalar) == want,
+                      "filtered, scalar verifier, " + what);
+                check(approximateMatch(text, pattern, k) == want,
+                      "approximateMatch " + what);
+            }
+        }
+    }
+}
+
+/* Streamed in random chunks, or with line breaks that are skipped, the
+   reported ends are the dp's */
+void testApproxStream() {
+    mt19937 rng(9);
+    for (size_t m : {1, 5, 63, 64, 65, 130}) {
+        for (int round = 0; round < 10; round++) {
+            string pattern = randomDNA(rng, m);
+            string text = approxText(rng, pattern, rng() % 400);
+            for (int k : {-1, 0, 1, 3, (int)m}) {
+                auto want = refApproxEnds(text, pattern, k);
+                string what = "m " + to_string(m) + " k " + to_string(k) +
+                              " on \"" + text + "\"";
+
+                vector<pair<size_t, int>> got;
+                ApproxStream stream(pattern, k);
+                for (size_t i = 0; i < text.size(); ) {
+                    size_t len = rng() % 50;
+                    stream.feed(string_view(text).substr(i, len),
+                                [&](size_t end, int errors) {
+                                    got.push_back({end, errors});
+                                });
+                    i += len;
+                }
+                check(got == want &&
+                      (k < 0 || stream.consumed() == text.size()),
+                      "ApproxStream " + what);
+
+                string wrapped;
+                for (size_t i = 0; i < text.size(); i++) {
+                    if (i % 7 == 0) wrapped += i % 14 ? "\n" : "\r\n";
+                    wrapped += text[i];
+                }
+                got.clear();
+                ApproxStream lines(pattern, k, true);
+                lines.feed(wrapped, [&](size_t end, int errors) {
+                    got.push_back({end, errors});
+                });
+                check(got == want, "ApproxStream skipping line breaks, " +
+                                   what);
+            }
+        }
+    }
+}
+
+/* Same answer as simulate with chunks of one byte up to more than the
+   whole text */
+void testParallelSimulate() {
+    ThreadPool pool(4);
+    mt19937 rng(11);
+    for (const char *regex : {"[ACGT]*GATTACA[ACGT]*", "(AC|GT)*",
+                              "A*C?G*T", ".*A..."}) {
+        FlatDFA dfa = compileFlat(regex);
+        for (int i = 0; i < 30; i++) {
+            string text = randomDNA(rng, rng() % 200);
+            if (i % 3 == 0) text.insert(rng() % (text.size() + 1), "GATTACA");
+            if (i % 5 == 0) text = string(rng() % 9, 'A') + "CGT";
+            bool want = dfa.simulate(text);
+            for (size_t chunk : {size_t(1), size_t(2), size_t(7), text.size(),
+                                 text.size() + 1, 3 * text.size() + 100})
+                check(parallelSimulate(dfa, text, pool, chunk) == want,
+                      string("parallelSimulate /") + regex + "/, chunk " +
+                      to_string(chunk) + ", on \"" + text + "\"");
+        }
+    }
+}
+
+/* Every (pattern, start) a naive search finds, with overlapping patterns
+   and patterns that are prefixes or suffixes of others */
+void testAhoCorasick() {
+    mt19937 rng(12);
+    vector<pair<vector<string>, string>> sets = {
+        {{"he", "she", "his", "hers"}, "ehirsx"},
+        {{"a", "aa", "aaa", "ba", "ab"}, "ab"},
+        {{"abc", "bc", "c", "abcd", "", "bc"}, "abcd"},
+    };
+    for (int i = 0; i < 40; i++) {
+        vector<string> patterns(1 + rng() % 6);
+        for (auto &p : patterns) {
+            p.resize(rng() % 5);
+            for (char &c : p) c = "ab"[rng() % 2];
+        }
+        sets.push_back({patterns, "abc"});
+    }
+    for (auto &[patterns, alphabet] : sets) {
+        AhoCorasick ac = buildAhoCorasick(patterns);
+        for (int t = 0; t < 20; t++) {
+            string text(t ? rng() % 30 : 0, ' ');
+            for (char &c : text) c = alphabet[rng() % alphabet.size()];
+
+            vector<pair<uint32_t, size_t>> want, got;
+            for (size_t s = 0; s < text.size(); s++)
+                for (uint32_t id = 0; id < patterns.size(); id++)
+                    if (!patterns[id].empty() &&
+                        text.compare(s, patterns[id].size(),
+                                     patterns[id]) == 0)
+                        want.push_back({id, s});
+            bool ordered = true;
+            size_t lastEnd = 0;
+            ac.search(text, [&](uint32_t id, size_t start) {
+                size_t end = start + patterns[id].size();
+                ordered = ordered && end >= lastEnd;
+                lastEnd = end;
+                got.push_back({id, start});
+            });
+            sort(got.begin(), got.end());
+            sort(want.begin(), want.end());
+            string what;
+            for (auto &p : patterns) what += " \"" + p + "\"";
+            check(got == want && ordered,
+                  "AhoCorasick" + what + " on \"" + text + "\"");
+        }
+    }
+}
+
+/* Prefiltered anchored scan against longestMatchAt at every offset */
+void testScanCandidates() {
+    mt19937 rng(13);
+    for (const char *regex : {"GATTACA", "GA", "(CA|GT)T*", "[AC]G",
+                              "A?C", "T*"}) {
+        FlatDFA dfa = compileFlat(regex);
+        Prefilter pf = buildPrefilter(dfa, dfa.startState, dfa.deadState);
+        for (int i = 0; i < 50; i++) {
+            string text(rng() % 200, 'A');
+            for (char &c : text) c = "ACGT"[rng() % 4];
+            if (i % 5 == 0) text.insert(rng() % (text.size() + 1), "GATTACA");
+
+            vector<pair<size_t, size_t>> want, got;
+            for (size_t s = 0; s <= text.size(); s++) {
+                size_t e = dfa.longestMatchAt(text, s);
+                if (e != string_view::npos) want.push_back({s, e});
+            }
+            size_t n = scanCandidates(dfa, pf, text, [&](size_t s, size_t e) {
+                got.push_back({s, e});
+            });
+            check(got == want && n == want.size(),
+                  string("scanCandidates /") + regex + "/ on \"" + text +
+                  "\"");
+        }
+    }
+}
+
+/* A match that starts earlier wins over one that ends earlier */
+void testSearcherLeftmost() {
+    Searcher searcher(regexToNFA("abcd|c"));
+    Match m;
+    check(searcher.findFirst("abcd", m) && m.start == 0 && m.end == 4,
+          "Searcher /abcd|c/ first match on \"abcd\"");
+    check(searcher.count("abcd") == 1 && searcher.count("abcdc") == 2,
+          "Searcher /abcd|c/ count");
+    check(searcher.findFirst("xabcd", m, 2) && m.start == 3 && m.end == 4,
+          "Searcher /abcd|c/ from inside a match");
+
+    /* Long enough to cross the backward pass's block boundaries */
+    mt19937 rng(14);
+    string text(300000, 'A');
+    for (char &c : text) c = "ACGT"[rng() % 4];
+    for (size_t at : {0, 65530, 65536, 131070, 262143, 299990})
+        text.replace(at, 10, "GATTACAGAT");
+    for (const char *regex : {"GATTACA(GAT)?", "ACG|CGT+", "T*"}) {
+        Searcher searcher(regexToNFA(regex));
+        FlatDFA anchored = compileFlat(regex);
+        vector<Match> want;
+        for (size_t i = 0; i <= text.size(); i++) {
+            size_t e = anchored.longestMatchAt(text, i);
+            if (e == string_view::npos) continue;
+            want.push_back({i, e});
+            if (e > i) i = e - 1;
+        }
+        check(searcher.findAll(text) == want,
+              string("Searcher /") + regex + "/ on a long text");
+    }
+}
+
+/* Every batch form against simulate one string at a time, with ragged
+   lengths so the lockstep lanes finish apart */
+void testBatchSimulate() {
+    mt19937 rng(15);
+    FlatDFA dfa = compileFlat("[ACGT]*GA(TT)*ACA");
+    string bytes;
+    vector<uint32_t> offsets{0};
+    for (int i = 0; i < 5000; i++) {
+        size_t len = rng() % 24;
+        for (size_t j = 0; j < len; j++) bytes += "ACGT"[rng() % 4];
+        if (i % 7 == 0) bytes += "GATTACA";
+        offsets.push_back(bytes.size());
+    }
+    vector<string_view> items;
+    vector<uint64_t> want((offsets.size() + 62) / 64, 0);
+    for (size_t i = 0; i + 1 < offsets.size(); i++) {
+        items.push_back(string_view(bytes).substr(offsets[i],
+                                                  offsets[i+1] - offsets[i]));
+        if (dfa.simulate(items.back()))
+            want[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+
+    ThreadPool pool(4);
+    check(batchSimulate(dfa, items) == want, "batchSimulate");
+    check(batchSimulate(dfa, bytes.data(), offsets.data(), items.size()) ==
+          want, "batchSimulate packed");
+    for (size_t grain : {1, 64, 100, 1 << 14})
+        check(batchSimulate(dfa, items, pool, grain) == want,
+              "batchSimulate pooled, grain " + to_string(grain));
+}
+
+/* A saved DFA loads back identical; damaged files are refused */
+void testFlatDFAFiles() {
+    const string path = "searchsystem_test.dfa";
+    FlatDFA dfa = compileFlat("(GA|TC)+[AC]?T*");
+    saveFlatDFA(dfa, path);
+    string good;
+    {
+        ifstream in(path, ios::binary);
+        good.assign(istreambuf_iterator<char>(in), {});
+    }
+    {
+        FlatDFA loaded = loadFlatDFA(path);
+        bool same = loaded.numStates == dfa.numStates &&
+                    loaded.numFinal == dfa.numFinal;
+        for (const char *t : {"", "GA", "GATCAT", "GAC", "TCTCCT", "T"})
+            same = same && loaded.simulate(t) == dfa.simulate(t);
+        check(same, "loadFlatDFA round trip");
+    }
+
+    auto write = [&](const string &bytes) {
+        ofstream out(path, ios::binary | ios::trunc);
+        out << bytes;
+    };
+    auto rejected = [&](const string &bytes, const string &what) {
+        write(bytes);
+        bool threw = false;
+        try {
+            loadFlatDFA(path);
+        } catch (const runtime_error &) {
+            threw = true;
+        }
+        check(threw, "loadFlatDFA rejects " + what);
+    };
+    auto patched = [&](size_t offset, auto value) {
+        string bytes = good;
+        memcpy(&bytes[offset], &value, sizeof value);
+        return bytes;
+    };
+
+    rejected(good.substr(0, sizeof(FlatDFAHeader) - 1), "a truncated header");
+    rejected(good.substr(0, good.size() - 1), "a truncated table");
+    rejected(patched(0, 'X'), "a bad magic");
+    rejected(patched(offsetof(FlatDFAHeader, version), FLAT_DFA_VERSION + 1),
+             "a newer version");
+    rejected(patched(offsetof(FlatDFAHeader, version), uint32_t(1)),
+             "version 1");
+    /* numStates + 1 wraps to 0 in 32 bits, making the table look empty */
+    string wrap = patched(offsetof(FlatDFAHeader, numStates), ~uint32_t(0));
+    memcpy(&wrap[offsetof(FlatDFAHeader, deadState)], &wrap[
+           offsetof(FlatDFAHeader, numStates)], sizeof(uint32_t));
+    memcpy(&wrap[offsetof(FlatDFAHeader, idBytes)], "\4\0\0\0", 4);
+    memset(&wrap[offsetof(FlatDFAHeader, tableBytes)], 0, sizeof(uint64_t));
+    rejected(wrap, "a wrapping state count");
+    rejected(patched(offsetof(FlatDFAHeader, tableOffset), ~uint64_t(63)),
+             "an overflowing table offset");
+    rejected(patched(offsetof(FlatDFAHeader, startState), dfa.numStates + 1),
+             "an out of range start state");
+
+    /* A table entry past the dead state is caught unless the caller
+       opts out of verification */
+    FlatDFAHeader h;
+    memcpy(&h, good.data(), sizeof h);
+    string entry = dfa.idBytes() == 2 ? patched(h.tableOffset, uint16_t(~0))
+                                      : patched(h.tableOffset, uint32_t(~0));
+    rejected(entry, "an out of range table entry");
+    write(entry);
+    check(loadFlatDFA(path, false).numStates == dfa.numStates,
+          "loadFlatDFA without verification");
+    remove(path.c_str());
+}
+
+/* The compile-time literal DFA agrees with the one regexToNFA builds */
+void testStaticLiteral() {
+    FlatDFA flat = compileFlat(PRIMER);
+    mt19937 rng(17);
+    for (int i = 0; i < 2000; i++) {
+        string text = PRIMER;
+        if (i % 3 == 0) text[rng() % text.size()] = "ACGT"[rng() % 4];
+        if (i % 3 == 1) text.resize(rng() % 12, "ACGT"[rng() % 4]);
+        bool want = flat.simulate(text);
+        check(primerDFA.simulate(text) == want &&
+              StaticLiteral<PRIMER>::simulate(text) == want,
+              "StaticLiteral on \"" + text + "\"");
+    }
+}
+
+/* Moves added one at a time, including after a simulate, take effect */
+void testPDABuild() {
+    PDA p;
+    p.addTransition(0, 'a', PDA::ANY, 0, PDA::Push, 'A');
+    p.addTransition(0, 'b', 'A', 1, PDA::Pop);
+    p.finalStates = {0, 1};
+    check(p.simulate("aab") == false && p.simulate("") == true,
+          "PDA before its last move");
+    p.addTransition(1, 'b', 'A', 1, PDA::Pop);
+    PDA anbn = PDA::anbn();
+    for (const char *t : {"", "ab", "aabb", "aab", "abb", "ba", "aaabbb"})
+        check(p.simulate(t) == anbn.simulate(t),
+              string("PDA built by moves on \"") + t + "\"");
+
+    /* Replacing a move */
+    p.addTransition(0, 'b', 'A', 0, PDA::Pop);
+    check(p.simulate("abab") && !anbn.simulate("abab"),
+          "PDA replaced move");
+
+    bool threw = false;
+    PDA big;
+    big.addTransition(0x7FFF, 'a', PDA::ANY, 0, PDA::Keep);
+    try {
+        big.simulate("a");
+    } catch (const invalid_argument &) {
+        threw = true;
+    }
+    check(threw, "PDA too large for its table");
+}
+
+/* '\0' and 0xFF are stack symbols like any other, not EMPTY or ANY */
+void testPDASymbols() {
+    PDA p;
+    p.addTransition(0, 'a', PDA::ANY, 0, PDA::Push, '\0');
+    p.addTransition(0, 'b', PDA::ANY, 0, PDA::Push, (char)0xFF);
+    p.addTransition(0, 'c', '\0', 0, PDA::Pop);
+    p.addTransition(0, 'd', (char)0xFF, 0, PDA::Pop);
+    p.addTransition(0, 'k', '\0', 0, PDA::Keep);
+    p.finalStates = {0};
+    for (const char *t : {"abdc", "akc", "abdkc", ""})
+        check(p.simulate(t), string("PDA symbols accept \"") + t + "\"");
+    for (const char *t : {"abcd", "ad", "k", "bc", "bk"})
+        check(!p.simulate(t), string("PDA symbols reject \"") + t + "\"");
+
+    bool threw = false;
+    try {
+        p.addTransition(0, 'x', 300, 0, PDA::Keep);
+    } catch (const invalid_argument &) {
+        threw = true;
+    }
+    check(threw, "PDA stack symbol out of range");
+}
+
+/* Whether input derives from the start symbol, as the least fixed point
+   of "sym derives input[i, j)" over all rules: slow, but shares nothing
+   with either recognizer */
+bool refDerives(const Grammar &g, string_view input) {
+    const int NT = Grammar::NT;
+    size_t n = input.size(), span = n + 1;
+    vector<char> d(g.numNonterminals() * span * span, 0);
+    auto at = [&](int a, size_t i, size_t j) -> char & {
+        return d[((a - NT) * span + i) * span + j];
+    };
+    auto derives = [&](int sym, size_t i, size_t j) -> bool {
+        if (sym < NT) return j == i + 1 && (unsigned char)input[i] == sym;
+        return at(sym, i, j);
+    };
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (size_t p = 0; p < g.lhs.size(); p++)
+            for (size_t i = 0; i <= n; i++) {
+                /* reach[j]: the rule's symbols so far derive input[i, j) */
+                vector<char> reach(span, 0), next(span);
+                reach[i] = 1;
+                for (int sym : g.rhs[p]) {
+                    fill(next.begin(), next.end(), 0);
+                    for (size_t a = i; a <= n; a++)
+                        for (size_t b = a; reach[a] && b <= n; b++)
+                            if (derives(sym, a, b)) next[b] = 1;
+                    reach.swap(next);
+                }
+                for (size_t j = i; j <= n; j++)
+                    if (reach[j] && !at(g.lhs[p], i, j))
+                        at(g.lhs[p], i, j) = changed = true;
+            }
+    }
+    return at(g.start, 0, n);
+}
+
+/* Earley, and CYK and Earley on the Chomsky normal form, against
+   refDerives on every short string over each grammar's alphabet */
+void testGrammars() {
+    vector<pair<Grammar, string>> grammars;
+    {   /* nullable: a* b? */
+        Grammar g;
+        int S = g.nonterminal("S"), A = g.nonterminal("A"),
+            B = g.nonterminal("B");
+        g.addRule(S, {A, B});
+        g.addRule(A, {'a', A});
+        g.addRule(A, {});
+        g.addRule(B, {'b'});
+        g.addRule(B, {});
+        grammars.push_back({g, "ab"});
+    }
+    {   /* left-recursive expressions */
+        Grammar g;
+        int E = g.nonterminal("E"), T = g.nonterminal("T");
+        g.addRule(E, {E, '+', T});
+        g.addRule(E, {T});
+        g.addRule(T, {'a'});
+        g.addRule(T, {'(', E, ')'});
+        grammars.push_back({g, "a+()"});
+    }
+    {   /* right-recursive */
+        Grammar g;
+        int S = g.nonterminal("S");
+        g.addRule(S, {'a', S});
+        g.addRule(S, {'b', S});
+        g.addRule(S, {'c'});
+        grammars.push_back({g, "abc"});
+    }
+    {   /* ambiguous and nullable: balanced parentheses */
+        Grammar g;
+        int S = g.nonterminal("S");
+        g.addRule(S, {S, S});
+        g.addRule(S, {'(', S, ')'});
+        g.addRule(S, {});
+        grammars.push_back({g, "()"});
+    }
+    {   /* ambiguous operators */
+        Grammar g;
+        int E = g.nonterminal("E");
+        g.addRule(E, {E, '+', E});
+        g.addRule(E, {E, '*', E});
+        g.addRule(E, {'a'});
+        grammars.push_back({g, "a+*"});
+    }
+    {   /* unit chains through nullable symbols */
+        Grammar g;
+        int S = g.nonterminal("S"), A = g.nonterminal("A"),
+            B = g.nonterminal("B");
+        g.addRule(S, {A, A, A});
+        g.addRule(A, {B});
+        g.addRule(B, {'b'});
+        g.addRule(B, {});
+        grammars.push_back({g, "bc"});
+    }
+
+    for (size_t gi = 0; gi < grammars.size(); gi++) {
+        auto &[g, alphabet] = grammars[gi];
+        Grammar cnf = chomskyNormalForm(g);
+        size_t maxLen = alphabet.size() <= 3 ? 6 : 5;
+        vector<string> texts{""};
+        for (size_t t = 0; t < texts.size(); t++)
+            if (texts[t].size() < maxLen)
+                for (char c : alphabet) texts.push_back(texts[t] + c);
+        for (const string &text : texts) {
+            bool want = refDerives(g, text);
+            string what = "grammar " + to_string(gi) + " on \"" + text + "\"";
+            check(earleyRecognize(g, text) == want, "Earley " + what);
+            check(cykRecognize(cnf, text) == want, "CYK " + what);
+            check(earleyRecognize(cnf, text) == want, "Earley, CNF, " + what);
+        }
+    }
+}
+
+/* Counters from two threads add up, and both exports keep their exact
+   format */
+void testStats() {
+    FlatDFA dfa = compileFlat("A*");
+    string text(1000, 'A');
+    StatsSnapshot before = statsSnapshot();
+    auto work = [&] {
+        dfa.simulate(text);
+        dfa.simulate("AAAAC");
+    };
+    thread a(work), b(work);
+    a.join();
+    b.join();
+    StatsSnapshot after = statsSnapshot();
+    auto delta = [&](Stat s) { return after[s] - before[s]; };
+    check(delta(StatBytesScanned) == 2 * 1005 &&
+          delta(StatDFATransitions) == 2 * 1005 &&
+          delta(StatDeadExits) == 2, "stats summed over two threads");
+
+    StatsSnapshot s;
+    for (uint32_t i = 0; i < NumStats; i++) s[i] = 10 * i + 1;
+    check(statsJSON(s) ==
+          "{\"bytes_scanned\": 1, \"dfa_transitions\": 11, "
+          "\"dfa_dead_exits\": 21, \"subset_states\": 31, "
+          "\"nfa_to_dfa_calls\": 41, \"nfa_to_dfa_nanoseconds\": 51, "
+          "\"dp_cells\": 61, \"pda_stack_high_water\": 71, "
+          "\"pattern_cache_hits\": 81, \"pattern_cache_misses\": 91, "
+          "\"pattern_cache_evictions\": 101}", "statsJSON format");
+    string prom =
+        "# HELP searchsystem_bytes_scanned_total"
+        " Input bytes read by all engines\n"
+        "# TYPE searchsystem_bytes_scanned_total counter\n"
+        "searchsystem_bytes_scanned_total 1\n"
+        "# HELP searchsystem_dfa_transitions_total"
+        " Table moves taken by DFA, LazyDFA and FlatDFA\n"
+        "# TYPE searchsystem_dfa_transitions_total counter\n"
+        "searchsystem_dfa_transitions_total 11\n"
+        "# HELP searchsystem_dfa_dead_exits_total"
+        " Scans cut short by reaching a dead state\n"
+        "# TYPE searchsystem_dfa_dead_exits_total counter\n"
+        "searchsystem_dfa_dead_exits_total 21\n"
+        "# HELP searchsystem_subset_states_total"
+        " DFA states created by nfaToDFA and LazyDFA\n"
+        "# TYPE searchsystem_subset_states_total counter\n"
+        "searchsystem_subset_states_total 31\n"
+        "# HELP searchsystem_nfa_to_dfa_calls_total"
+        " Completed nfaToDFA calls\n"
+        "# TYPE searchsystem_nfa_to_dfa_calls_total counter\n"
+        "searchsystem_nfa_to_dfa_calls_total 41\n"
+        "# HELP searchsystem_nfa_to_dfa_nanoseconds_total"
+        " Time spent in nfaToDFA\n"
+        "# TYPE searchsystem_nfa_to_dfa_nanoseconds_total counter\n"
+        "searchsystem_nfa_to_dfa_nanoseconds_total 51\n"
+        "# HELP searchsystem_dp_cells_total"
+        " Edit-distance cells evaluated (bit-parallel included)\n"
+        "# TYPE searchsystem_dp_cells_total counter\n"
+        "searchsystem_dp_cells_total 61\n"
+        "# HELP searchsystem_pda_stack_high_water Deepest PDA stack seen\n"
+        "# TYPE searchsystem_pda_stack_high_water gauge\n"
+        "searchsystem_pda_stack_high_water 71\n";
+    prom +=
+        "# HELP searchsystem_pattern_cache_hits_total"
+        " PatternCache lookups served from cache\n"
+        "# TYPE searchsystem_pattern_cache_hits_total counter\n"
+        "searchsystem_pattern_cache_hits_total 81\n"
+        "# HELP searchsystem_pattern_cache_misses_total"
+        " PatternCache lookups that compiled\n"
+        "# TYPE searchsystem_pattern_cache_misses_total counter\n"
+        "searchsystem_pattern_cache_misses_total 91\n"
+        "# HELP searchsystem_pattern_cache_evictions_total"
+        " PatternCache entries evicted\n"
+        "# TYPE searchsystem_pattern_cache_evictions_total counter\n"
+        "searchsystem_pattern_cache_evictions_total 101\n";
+    check(statsPrometheus(s) == prom, "statsPrometheus format");
+}
+
+/* Serve-mode requests, including malformed edit distances */
+void testQueryServer() {
+    PatternCache cache;
+    QueryServer server(cache);
+    auto reply = [&](const string &request, const string &want) {
+        string got = server.handle(request);
+        check(got == want, "serve \"" + request + "\" gave \"" + got + "\"");
+    };
+    reply("match\tGA(T|C)+\tGATTC", "1");
+    reply("search\tabcd|c\tabcdc", "2 0 4");
+    reply("approx\t1\tGATTACA\tCCGATCACACC", "1");
+    reply("approx\t0\tGATTACA\tCCGATCACACC", "0");
+    reply("approx\t1\tGA(TT|CC)ACA\tCCGACCTACACC", "1");
+    reply("approx\t0\tGA(TT|CC)ACA\tCCGACCTACACC", "0");
+    for (const char *k : {"99999999999", "-1", "+1", "1x", "", " 1"})
+        reply(string("approx\t") + k + "\tA\tA", "ERR invalid edit distance");
+    reply("anbn\taabb", "1");
+    reply("nope", "ERR unknown command");
+}
+
+/* Hits and misses are counted, a hit returns the cached object, CLOCK
+   gives a recently used entry a second chance, and concurrent lookups
+   all see one compiled pattern per key */
+void testPatternCache() {
+    auto counted = [](Stat s) { return statsSnapshot()[s]; };
+    size_t each;
+    {
+        PatternCache sizing;
+        each = sizing.get("a")->bytes;
+    }
+
+    /* One shard with room for exactly three single-letter patterns */
+    PatternCache cache(3 * each, 1);
+    uint64_t hits = counted(StatPatternHits),
+             misses = counted(StatPatternMisses),
+             evictions = counted(StatPatternEvictions);
+    auto a = cache.get("a");
+    check(cache.get("a") == a && cache.get("a")->dfa.simulate("a"),
+          "PatternCache hit returns the cached pattern");
+    PatternOptions search;
+    search.search = true;
+    check(cache.get("a", search) != a && cache.get("a", search)->searcher,
+          "PatternCache keys include the options");
+    check(counted(StatPatternHits) - hits == 3 &&
+          counted(StatPatternMisses) - misses == 2,
+          "PatternCache hit and miss counts");
+
+    /* Entries start referenced; a full sweep clears every flag before
+       the first eviction, and a hit sets the flag again */
+    cache.clear();
+    cache.get("a");
+    cache.get("b");
+    cache.get("c");
+    cache.get("d");       /* clears all three flags, evicts "a" */
+    cache.get("b");       /* hit: "b" gets a second chance */
+    cache.get("e");       /* skips "b", evicts "c" */
+    hits = counted(StatPatternHits);
+    misses = counted(StatPatternMisses);
+    cache.get("b");
+    cache.get("d");
+    cache.get("e");
+    check(counted(StatPatternHits) - hits == 3 &&
+          counted(StatPatternMisses) == misses,
+          "PatternCache keeps the entries CLOCK should keep");
+    cache.get("c");
+    check(counted(StatPatternMisses) - misses == 1 &&
+          counted(StatPatternEvictions) - evictions >= 3,
+          "PatternCache evicts the entries CLOCK should evict");
+    check(cache.size() <= 3 && cache.memoryBytes() <= 3 * each,
+          "PatternCache stays within its budget");
+
+    PatternCache shared;
+    vector<string> patterns;
+    for (int i = 0; i < 20; i++)
+        patterns.push_back("GA" + string(i, 'T') + "(C|A)+");
+    vector<vector<shared_ptr<const CompiledPattern>>> seen(8);
+    vector<thread> threads;
+    for (auto &mine : seen)
+        threads.emplace_back([&] {
+            for (int round = 0; round < 50; round++)
+                for (auto &p : patterns) mine.push_back(shared.get(p));
+        });
+    for (auto &t : threads) t.join();
+    bool same = shared.size() == patterns.size();
+    for (auto &mine : seen)
+        for (size_t i = 0; i < mine.size(); i++) {
+            size_t id = i % patterns.size();
+            same = same && mine[i] == shared.get(patterns[id]) &&
+                   mine[i]->dfa.simulate("GA" + string(id, 'T') + "CA");
+        }
+    check(same, "PatternCache concurrent lookups share one pattern per key");
+}
+
+/* The cut-off reports every end the full dp does, or only the first */
+void testUkkonenHits() {
+    mt19937 rng(25);
+    for (size_t m : {1, 4, 20, 64, 65, 150}) {
+        for (int round = 0; round < 10; round++) {
+            string pattern = randomDNA(rng, m);
+            string text = approxText(rng, pattern, rng() % 300);
+            for (int k : {-1, 0, 1, 2, 5, (int)m}) {
+                auto want = refApproxEnds(text, pattern, k);
+                string what = "m " + to_string(m) + " k " + to_string(k) +
+                              " on \"" + text + "\"";
+                vector<pair<size_t, int>> all, first;
+                size_t n = approximateUkkonen(text, pattern, k,
+                                              [&](size_t end, int errors) {
+                                                  all.push_back({end, errors});
+                                              });
+                check(all == want && n == want.size(), "Ukkonen ends " + what);
+                n = approximateUkkonen(text, pattern, k,
+                                       [&](size_t end, int errors) {
+                                           first.push_back({end, errors});
+                                       }, true);
+                want.resize(min<size_t>(want.size(), 1));
+                check(first == want && n == want.size(),
+                      "Ukkonen first hit " + what);
+            }
+        }
+    }
+}
+
+/* Ends of approximate matches of nfa with their fewest edits: dist[q] is
+   the fewest edits that bring some substring ending here to state q.
+   Reading byte c takes an edge for free if it is labelled c and for one
+   edit otherwise (a substitution), or stays put for one (an insertion);
+   between bytes, epsilon moves are free and labelled edges cost one (a
+   deletion). Ends before the shortest match length do not count. */
+vector<pair<size_t, int>> refApproxRegexEnds(const NFA &nfa,
+                                             string_view text, int k) {
+    struct Edge { int from, to; bitset<256> on; };
+    vector<Edge> edges;
+    int top = nfa.startState;
+    for (auto &[from, row] : nfa.transitions) {
+        map<int, bitset<256>> on;
+        for (auto &[c, tos] : row)
+            for (int to : tos) on[to].set((unsigned char)c);
+        for (auto &[to, bytes] : on) {
+            edges.push_back({from, to, bytes});
+            top = max({top, from, to});
+        }
+    }
+    for (auto &[from, tos] : nfa.epsilon)
+        for (int to : tos) top = max({top, from, to});
+
+    const int INF = 1 << 20;
+    auto settle = [&](vector<int> &dist) {
+        for (bool changed = true; changed; ) {
+            changed = false;
+            auto relax = [&](int to, int cost) {
+                if (cost < dist[to]) {
+                    dist[to] = cost;
+                    changed = true;
+                }
+            };
+            for (auto &[from, tos] : nfa.epsilon)
+                for (int to : tos) relax(to, dist[from]);
+            for (auto &e : edges) relax(e.to, dist[e.from] + 1);
+        }
+    };
+    auto best = [&](const vector<int> &dist) {
+        int b = INF;
+        for (int f : nfa.finalStates) b = min(b, dist[f]);
+        return b;
+    };
+
+    /* Deletions only from the start: the shortest match length */
+    vector<int> dist(top + 1, INF);
+    dist[nfa.startState] = 0;
+    settle(dist);
+    size_t minLength = best(dist);
+
+    vector<pair<size_t, int>> out;
+    for (size_t i = 1; i <= text.size(); i++) {
+        unsigned char c = text[i-1];
+        vector<int> next(top + 1, INF);
+        for (int q = 0; q <= top; q++) next[q] = min(INF, dist[q] + 1);
+        for (auto &e : edges)
+            next[e.to] = min(next[e.to], dist[e.from] + !e.on[c]);
+        next[nfa.startState] = 0;
+        settle(next);
+        dist.swap(next);
+        int errors = best(dist);
+        if (i >= minLength && errors <= k) out.push_back({i, errors});
+    }
+    return out;
+}
+
+/* ApproxRegex at k = 1..3 against refApproxRegexEnds on random regexes
+   with classes and alternation, one- and multi-word; on literals it must
+   also give approximateMatchDP's answer */
+void testApproxRegex() {
+    mt19937 rng(26);
+    vector<string> regexes = {"GA(T|C)A", "[AC]G|T+A", "G[^T]T?C+",
+                              "(GATTACA)+|CC", string(70, 'A') + "(C|G)",
+                              "(" + string(40, 'T') + "|" +
+                              string(40, 'G') + ")A"};
+    for (int i = 0; i < 60; i++)
+        regexes.push_back(randomRegex(rng, 3, "ACGT", true));
+    for (const string &regex : regexes) {
+        NFA nfa = regexToNFA(regex);
+        for (int k = 1; k <= 3; k++) {
+            ApproxRegex approx(nfa, k);
+            for (int t = 0; t < 6; t++) {
+                string text = randomDNA(rng, rng() % 120);
+                vector<pair<size_t, int>> got;
+                approx.scan(text, [&](size_t end, int errors) {
+                    got.push_back({end, errors});
+                });
+                auto want = refApproxRegexEnds(nfa, text, k);
+                check(got == want && approx.match(text) == !want.empty(),
+                      "ApproxRegex /" + regex + "/ k " + to_string(k) +
+                      " on \"" + text + "\"");
+            }
+        }
+    }
+
+    for (size_t m : {1, 5, 30, 64, 65, 100}) {
+        for (int round = 0; round < 6; round++) {
+            string pattern = randomDNA(rng, m);
+            NFA nfa = regexToNFA(pattern);
+            string text = approxText(rng, pattern, 1 + rng() % 200);
+            for (int k = 0; k <= 3; k++)
+                check(ApproxRegex(nfa, k).match(text) ==
+                      approximateMatchDP(text, pattern, k),
+                      "ApproxRegex literal " + pattern + " k " +
+                      to_string(k) + " on \"" + text + "\"");
+        }
+    }
+}
+
+/* The window verifier approximateMatchFiltered picks, against the scalar
+   one it replaces */
+void testVerifyWindows() {
+    VerifyWindowFn best = chooseVerifyWindow();
+    if (best == verifyWindowScalar) return;    /* nothing else to compare */
+    mt19937 rng(27);
+    for (int i = 0; i < 3000; i++) {
+        size_t m = 1 + rng() % 70;
+        string pattern = randomDNA(rng, m);
+        string window = approxText(rng, pattern, rng() % (3 * m));
+        int k = rng() % m;
+        size_t minEnd = 1 + rng() % (window.size() + 1);
+        check(best(window, pattern, k, minEnd) ==
+              verifyWindowScalar(window, pattern, k, minEnd),
+              "window verifier, k " + to_string(k) + " from " +
+              to_string(minEnd) + ", " + pattern + " in \"" + window + "\"");
+    }
+}
+
+/* Appending in chunks of any size gives the one-shot encoding */
+void testPackedAppend() {
+    mt19937 rng(28);
+    string dna(100000, 'A');
+    for (char &c : dna) c = "ACGTacgt"[rng() % 8];
+    PackedDNA whole(dna), chunked;
+    for (size_t i = 0; i < dna.size(); ) {
+        size_t len = rng() % 70;
+        chunked.append(string_view(dna).substr(i, len));
+        i += len;
+    }
+    check(chunked.size() == dna.size() && chunked.unpack() == whole.unpack(),
+          "PackedDNA chunked append");
+    check(chunked.memoryBytes() <= 2 * whole.memoryBytes() + 64,
+          "PackedDNA append growth");
+
+    PackedDNA lines;
+    lines.append("ACG\nT", true);
+    lines.append("\r\nGA", true);
+    check(lines.unpack() == "ACGTGA", "PackedDNA skips line breaks");
+}
+
+/* Scans over packed bases agree with the same scans over the bytes, for
+   lengths that leave a partial last byte or word */
+void testPackedScans() {
+    mt19937 rng(128);
+    for (const char *regex : {"[ACGT]*GATTACA[ACGT]*", "(AC|GT)*", "A*C?G*T",
+                              "(A|C)*G(A|C|G|T)(A|C|G|T)"}) {
+        FlatDFA dfa = compileFlat(regex);
+        PackedDFA packed(dfa);
+        for (int i = 0; i < 60; i++) {
+            string text = randomDNA(rng, i < 40 ? i : rng() % 300);
+            if (i % 4 == 0) text.insert(rng() % (text.size() + 1), "GATTACA");
+            check(packed.simulate(PackedDNA(text)) == dfa.simulate(text),
+                  string("PackedDFA /") + regex + "/ on \"" + text + "\"");
+        }
+    }
+
+    for (size_t m : {1, 3, 13, 63, 64, 65, 129}) {
+        for (int round = 0; round < 10; round++) {
+            string pattern = randomDNA(rng, m);
+            string text = approxText(rng, pattern, rng() % 203);
+            if (round == 9) pattern[rng() % m] = 'N';
+            PackedDNA dna(text);
+            for (int k : {0, 1, 2, (int)m - 1, (int)m})
+                check(approximateMatchMyers(dna, pattern, k) ==
+                      approximateMatchMyers(text, pattern, k),
+                      "packed Myers " + pattern + " k " + to_string(k) +
+                      " on \"" + text + "\"");
+        }
+    }
+}
+
+/* Reordering keeps the language, numbers accepting states first and
+   hottest first within each group; ids switch to 32 bits at 65536
+   states */
+void testDFALayout() {
+    mt19937 rng(29);
+    for (int i = 0; i < 60; i++) {
+        string regex = randomRegex(rng, 3, "ACGT", true);
+        FlatDFA dfa = compileFlat(regex);
+        string sample = randomDNA(rng, 500);
+        FlatDFA hot = reorderDFA(dfa, profileDFA(dfa, sample));
+        bool ok = hot.numStates == dfa.numStates &&
+                  hot.numFinal == dfa.numFinal;
+        for (int t = 0; t < 20; t++) {
+            string text = randomDNA(rng, rng() % 12);
+            ok = ok && hot.simulate(text) == dfa.simulate(text);
+        }
+        /* A state accepts iff the empty string after it does, i.e. iff
+           it is below numFinal; visits count down within each group */
+        vector<uint64_t> visits = profileDFA(hot, sample);
+        for (uint32_t s = 0; s + 1 < hot.numStates; s++)
+            if (s + 1 != hot.numFinal)
+                ok = ok && visits[s] >= visits[s + 1];
+        check(ok, "reorderDFA /" + regex + "/");
+    }
+
+    for (uint32_t n : {0xFFFFu, 0x10000u}) {
+        /* A chain that accepts exactly n - 1 bytes */
+        ByteClasses one;
+        vector<uint32_t> table(n + 1);
+        for (uint32_t s = 0; s < n; s++) table[s] = s + 1;
+        table[n] = n;
+        vector<bool> accepting(n, false);
+        accepting[n - 1] = true;
+        FlatDFA chain = assembleDFA(one, table, accepting, 0);
+        string what = "chain of " + to_string(n) + " states";
+        check(chain.idBytes() == (n < 0x10000 ? 2u : 4u) &&
+              chain.memoryBytes() == (size_t)(n + 1) * chain.idBytes(),
+              "id width, " + what);
+        check(chain.simulate(string(n - 1, 'x')) &&
+              !chain.simulate(string(n - 2, 'x')) &&
+              !chain.simulate(string(n, 'x')), "simulate, " + what);
+
+        const string path = "searchsystem_test.dfa";
+        saveFlatDFA(chain, path);
+        FlatDFA loaded = loadFlatDFA(path);
+        check(loaded.idBytes() == chain.idBytes() &&
+              loaded.simulate(string(n - 1, 'x')) &&
+              !loaded.simulate(string(n, 'x')), "file round trip, " + what);
+        remove(path.c_str());
+    }
+}
+
+} // namespace
+
+int main() {
+    testOptionalGroups();
+    testRandomRegexes();
+    testLazyDFAFlush();
+    testApproxMatchers();
+    testApproxStream();
+    testParallelSimulate();
+    testAhoCorasick();
+    testScanCandidates();
+    testSearcherLeftmost();
+    testBatchSimulate();
+    testFlatDFAFiles();
+    testStaticLiteral();
+    testPDABuild();
+    testPDASymbols();
+    testGrammars();
+    testStats();
+    testQueryServer();
+    testPatternCache();
+    testUkkonenHits();
+    testApproxRegex();
+    testVerifyWindows();
+    testPackedAppend();
+    testPackedScans();
+    testDFALayout();
+    printf("%d failure%s\n", failures, failures == 1 ? "" : "s");
+    return failures;
+}
@@ -0,0 +1,12 @@
+#!/bin/sh
+# Builds the page's engine: writes Web/App/PAge/searchsystem.js and
+# searchsystem.wasm from wasm/searchsystem_wasm.cpp. Needs Emscripten's
+# em++ on the PATH; extra arguments are passed through to it.
+set -e
+cd "$(dirname "$0")/.."
+exec em++ -std=c++17 -O3 -fexceptions \
+    -sMODULARIZE -sEXPORT_NAME=createSearchSystem \
+    -sENVIRONMENT=worker -sALLOW_MEMORY_GROWTH \
+    -sEXPORTED_FUNCTIONS=_malloc,_free,_ss_compile,_ss_release,_ss_match,_ss_nfa_match,_ss_approx,_ss_describe,_ss_error \
+    -sEXPORTED_RUNTIME_METHODS=HEAPU8,UTF8ToString \
+    -o Web/App/PAge/searchsystem.js wasm/searchsystem_wasm.cpp "$@"
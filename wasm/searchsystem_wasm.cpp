@@ -0,0 +1,230 @@
+/* WebAssembly bindings for the searchsystem.cpp engines, loaded by
+   Web/App/PAge/engine-worker.js so the page runs the same automata as
+   the command line.
+
+   Build with wasm/build.sh (Emscripten's em++ on the PATH), which
+   writes searchsystem.js and searchsystem.wasm next to the page. The
+   page has no matchers of its own; without them it says the engine is
+   not built.
+
+   Everything is a C function over integers and pointers into the module
+   heap. ss_compile returns a handle, or 0 with ss_error() saying why.
+   Texts are (pointer, length) byte ranges the caller allocates with
+   malloc. Returned strings belong to the module and stay valid until
+   the next call that returns one. */
+#define SEARCHSYSTEM_NO_MAIN
+#include "../searchsystem.cpp"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#define SS_EXPORT extern "C" EMSCRIPTEN_KEEPALIVE
+#else
+#define SS_EXPORT extern "C"
+#endif
+
+namespace {
+
+/* One compiled regex: the NFA and subset DFA the page draws, the
+   minimized flat DFA for exact matching, and one bit-parallel
+   approximate matcher per error bound asked for so far */
+struct Engine {
+    NFA nfa;
+    DFA dfa;
+    FlatDFA flat;
+    map<int, unique_ptr<const ApproxRegex>> approx;
+};
+
+vector<unique_ptr<Engine>> engines;   /* handle h is engines[h - 1] */
+string lastError, lastText;
+
+Engine *lookup(int handle) {
+    if (handle <= 0 || (size_t)handle > engines.size()) return nullptr;
+    return engines[handle - 1].get();
+}
+
+string_view bytes(const char *text, size_t len) {
+    return len ? string_view(text, len) : string_view();
+}
+
+void jsonString(string &out, string_view s) {
+    out += '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof esc, "\\u%04x", c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+/* One byte as a pattern would spell it: printable ASCII as itself
+   (backslashed if special, inside [...] when inClass), \n \t \r,
+   otherwise \xNN, so labels are always plain ASCII */
+void appendByte(string &out, unsigned char c, bool inClass) {
+    if (c == '\n') out += "\\n";
+    else if (c == '\t') out += "\\t";
+    else if (c == '\r') out += "\\r";
+    else if (c > 0x20 && c < 0x7F) {
+        if (c == '\\' || (inClass && strchr("-[]^", c))) out += '\\';
+        out += c;
+    } else {
+        char hex[8];
+        snprintf(hex, sizeof hex, "\\x%02x", c);
+        out += hex;
+    }
+}
+
+/* All the bytes of one edge as a single label: "a", "[0-9a-f]", or the
+   complement ("[^\n]") when the edge takes most bytes */
+string edgeLabel(const bitset<256> &bytes) {
+    string out;
+    if (bytes.count() == 1) {
+        for (int b = 0; b < 256; b++)
+            if (bytes[b]) appendByte(out, b, false);
+        return out;
+    }
+    bitset<256> shown = bytes;
+    out = "[";
+    if (bytes.count() > 128 && !bytes.all()) {
+        shown.flip();
+        out += '^';
+    }
+    for (int b = 0; b < 256; b++) {
+        if (!shown[b]) continue;
+        int e = b;
+        while (e + 1 < 256 && shown[e + 1]) e++;
+        appendByte(out, b, true);
+        if (e > b + 1) out += '-';
+        if (e > b) appendByte(out, e, true);
+        b = e;
+    }
+    return out + "]";
+}
+
+/* {"start":S,"states":[...],"finals":[...],
+    "transitions":[[from,"label",to],...]}: one entry per pair of
+   states, labelled by edgeLabel, epsilon moves labelled "ε" */
+template <class Automaton, class Edges>
+void jsonAutomaton(string &out, const Automaton &a, Edges &&edges) {
+    out += "{\"start\":" + to_string(a.startState) + ",\"states\":[";
+    const char *sep = "";
+    for (int s : a.states) {
+        out += sep + to_string(s);
+        sep = ",";
+    }
+    out += "],\"finals\":[";
+    sep = "";
+    for (int s : a.finalStates) {
+        out += sep + to_string(s);
+        sep = ",";
+    }
+    out += "],\"transitions\":[";
+    sep = "";
+    edges([&](int from, string_view label, int to) {
+        out += sep;
+        out += "[" + to_string(from) + ",";
+        jsonString(out, label);
+        out += "," + to_string(to) + "]";
+        sep = ",";
+    });
+    out += "]}";
+}
+
+} // namespace
+
+SS_EXPORT int ss_compile(const char *regex, size_t len) {
+    try {
+        auto e = make_unique<Engine>();
+        e->nfa = regexToNFA(string(bytes(regex, len)));
+        e->dfa = nfaToDFA(e->nfa);
+        e->flat = compileDFA(e->dfa, true);
+
+        for (size_t i = 0; i < engines.size(); i++)
+            if (!engines[i]) {
+                engines[i] = std::move(e);
+                return i + 1;
+            }
+        engines.push_back(std::move(e));
+        return engines.size();
+    } catch (const exception &ex) {
+        lastError = ex.what();
+        return 0;
+    }
+}
+
+SS_EXPORT void ss_release(int handle) {
+    if (lookup(handle)) engines[handle - 1].reset();
+}
+
+/* 1 if the whole text is in the language, 0 if not, -1 on a bad handle */
+SS_EXPORT int ss_match(int handle, const char *text, size_t len) {
+    Engine *e = lookup(handle);
+    return e ? e->flat.simulate(bytes(text, len)) : -1;
+}
+
+/* Same answer through the Thompson NFA, for the page's side-by-side view */
+SS_EXPORT int ss_nfa_match(int handle, const char *text, size_t len) {
+    Engine *e = lookup(handle);
+    return e ? e->nfa.simulate(string(bytes(text, len))) : -1;
+}
+
+/* 1 if some substring is within maxErrors edits of the language, 0 if
+   not, -1 with ss_error() saying why on a bad handle or error bound */
+SS_EXPORT int ss_approx(int handle, const char *text, size_t len,
+                        int maxErrors) {
+    Engine *e = lookup(handle);
+    if (!e) {
+        lastError = "unknown automaton handle";
+        return -1;
+    }
+    if (maxErrors < 0) {
+        lastError = "negative edit distance";
+        return -1;
+    }
+    try {
+        auto &m = e->approx[maxErrors];
+        if (!m) m = make_unique<const ApproxRegex>(e->nfa, maxErrors);
+        return m->match(bytes(text, len));
+    } catch (const exception &ex) {
+        e->approx.erase(maxErrors);
+        lastError = ex.what();
+        return -1;
+    }
+}
+
+/* {"nfa":{...},"dfa":{...}} for drawing, or "" on a bad handle */
+SS_EXPORT const char *ss_describe(int handle) {
+    Engine *e = lookup(handle);
+    lastText.clear();
+    if (!e) return lastText.c_str();
+
+    lastText = "{\"nfa\":";
+    jsonAutomaton(lastText, e->nfa, [&](auto &&edge) {
+        for (auto &[from, row] : e->nfa.transitions) {
+            map<int, bitset<256>> bytes;
+            for (auto &[c, tos] : row)
+                for (int to : tos) bytes[to].set((unsigned char)c);
+            for (auto &[to, on] : bytes) edge(from, edgeLabel(on), to);
+        }
+        for (auto &[from, tos] : e->nfa.epsilon)
+            for (int to : tos) edge(from, "ε", to);
+    });
+    lastText += ",\"dfa\":";
+    jsonAutomaton(lastText, e->dfa, [&](auto &&edge) {
+        for (auto &[from, row] : e->dfa.transitions) {
+            map<int, bitset<256>> bytes;
+            for (auto &[c, to] : row) bytes[to].set((unsigned char)c);
+            for (auto &[to, on] : bytes) edge(from, edgeLabel(on), to);
+        }
+    });
+    lastText += "}";
+    return lastText.c_str();
+}
+
+SS_EXPORT const char *ss_error() { return lastError.c_str(); }